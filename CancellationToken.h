@@ -0,0 +1,58 @@
+/* Author: Hanuman Chu
+ *
+ * Creates CancellationToken class which lets any thread ask a running search to end as soon as possible, where copies of a token share
+ * one flag so a copy can be handed to the thread doing the cancelling, and SearchCancelled which leaf evaluators throw when they give up
+ * on a batch because its token was cancelled
+ */
+#ifndef CANCELLATION_TOKEN_H
+#define CANCELLATION_TOKEN_H
+
+#include <memory>
+#include <atomic>
+#include <stdexcept>
+using namespace std;
+
+class SearchCancelled : public runtime_error {
+public:
+	/**
+	 * @brief Constructs the error thrown in place of the results of a batch which was not evaluated because its search was cancelled
+	 */
+	SearchCancelled() : runtime_error("Search was cancelled.") {}
+};
+
+class CancellationToken {
+public:
+	/**
+	 * @brief Constructs a token which is not cancelled
+	 */
+	CancellationToken() : mCancelled(make_shared<atomic<bool>>(false)) {}
+
+	/**
+	 * @brief Cancels every search checking this token or a copy of it, which stays cancelled until reset is called
+	 */
+	void cancel() {
+		mCancelled->store(true, memory_order_release);
+	}
+
+	/**
+	 * @brief Lets searches checking this token or a copy of it run again
+	 */
+	void reset() {
+		mCancelled->store(false, memory_order_release);
+	}
+
+	/**
+	 * @brief Returns whether the token was cancelled
+	 * @return true if cancelled, false otherwise
+	 */
+	bool isCancelled() const {
+		return mCancelled->load(memory_order_acquire);
+	}
+private:
+	/**
+	 * @brief whether the token was cancelled, shared by every copy
+	 */
+	shared_ptr<atomic<bool>> mCancelled;
+};
+
+#endif
@@ -0,0 +1,169 @@
+/* Author: Hanuman Chu
+ *
+ * Creates EvaluationCache class which remembers the most recently used neural network evaluations by game state hash so game states seen
+ * in earlier searches are not run through the neural network again, where each evaluation is tagged with the version of the model that made it
+ */
+#ifndef EVALUATION_CACHE_H
+#define EVALUATION_CACHE_H
+
+#include <vector>
+#include <list>
+#include <iterator>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+using namespace std;
+
+const size_t EVALUATION_CACHE_CAPACITY = 1 << 16;
+
+class EvaluationCache {
+public:
+	/**
+	 * @brief Constructs an empty cache holding up to the given number of evaluations
+	 * @param CAPACITY most evaluations kept, where 0 turns the cache off
+	 */
+	EvaluationCache(const size_t CAPACITY = EVALUATION_CACHE_CAPACITY) : mCapacity(CAPACITY), mHits(0), mLookups(0) {}
+
+	/**
+	 * @brief Looks up the evaluation of a game state made by the given model version and marks it as the most recently used
+	 * @param HASH hash of the game state
+	 * @param VERSION version of the model the evaluation has to come from
+	 * @param result set to the evaluation if it was found
+	 * @return true if the evaluation was found, false otherwise
+	 */
+	bool find(const uint64_t HASH, const unsigned int VERSION, pair<vector<float>, float>& result) {
+		mLookups.fetch_add(1, memory_order_relaxed);
+		lock_guard<mutex> lock(mMutex);
+		auto found = mIndex.find(HASH);
+		if (found == mIndex.end() || found->second->version != VERSION) {
+			return false;
+		}
+
+		mEntries.splice(mEntries.begin(), mEntries, found->second);
+		result = found->second->evaluation;
+		mHits.fetch_add(1, memory_order_relaxed);
+		return true;
+	}
+
+	/**
+	 * @brief Stores the evaluation of a game state as the most recently used, replacing any older evaluation of it and dropping the least
+	 *        recently used evaluation if the cache is full
+	 * @param HASH hash of the game state
+	 * @param VERSION version of the model which made the evaluation
+	 * @param EVALUATION move probabilities and value of the game state
+	 */
+	void insert(const uint64_t HASH, const unsigned int VERSION, const pair<vector<float>, float>& EVALUATION) {
+		lock_guard<mutex> lock(mMutex);
+		if (mCapacity == 0) {
+			return;
+		}
+
+		auto found = mIndex.find(HASH);
+		if (found != mIndex.end()) {
+			found->second->version = VERSION;
+			found->second->evaluation = EVALUATION;
+			mEntries.splice(mEntries.begin(), mEntries, found->second);
+			return;
+		}
+
+		//Reuses the least recently used entry instead of freeing it so a full cache stops allocating
+		if (mEntries.size() >= mCapacity) {
+			mIndex.erase(mEntries.back().hash);
+			mEntries.splice(mEntries.begin(), mEntries, prev(mEntries.end()));
+			mEntries.front() = {HASH, VERSION, EVALUATION};
+		} else {
+			mEntries.push_front({HASH, VERSION, EVALUATION});
+		}
+		mIndex[HASH] = mEntries.begin();
+	}
+
+	/**
+	 * @brief Sets the most evaluations kept, dropping the least recently used ones if there are more than that
+	 * @param CAPACITY most evaluations kept, where 0 turns the cache off
+	 */
+	void setCapacity(const size_t CAPACITY) {
+		lock_guard<mutex> lock(mMutex);
+		mCapacity = CAPACITY;
+		while (mEntries.size() > mCapacity) {
+			mIndex.erase(mEntries.back().hash);
+			mEntries.pop_back();
+		}
+	}
+
+	/**
+	 * @brief Removes every evaluation and resets the hit rate
+	 */
+	void clear() {
+		lock_guard<mutex> lock(mMutex);
+		mEntries.clear();
+		mIndex.clear();
+		mHits.store(0);
+		mLookups.store(0);
+	}
+
+	/**
+	 * @brief Returns the number of evaluations kept
+	 * @return number of evaluations
+	 */
+	size_t size() {
+		lock_guard<mutex> lock(mMutex);
+		return mEntries.size();
+	}
+
+	/**
+	 * @brief Returns the fraction of lookups which found an evaluation since the cache was made or cleared
+	 * @return hit rate, 0 if nothing was looked up
+	 */
+	float getHitRate() const {
+		unsigned long long lookups = mLookups.load();
+		return lookups == 0 ? 0.0f : (float)mHits.load() / lookups;
+	}
+private:
+	/**
+	 * @brief Evaluation of one game state
+	 */
+	struct Entry {
+		/**
+		 * @brief hash of the game state
+		 */
+		uint64_t hash;
+		/**
+		 * @brief version of the model which made the evaluation
+		 */
+		unsigned int version;
+		/**
+		 * @brief move probabilities and value of the game state
+		 */
+		pair<vector<float>, float> evaluation;
+	};
+
+	/**
+	 * @brief most evaluations kept
+	 */
+	size_t mCapacity;
+	/**
+	 * @brief evaluations from most to least recently used
+	 */
+	list<Entry> mEntries;
+	/**
+	 * @brief position of the evaluation of each game state hash in mEntries
+	 */
+	unordered_map<uint64_t, list<Entry>::iterator> mIndex;
+	/**
+	 * @brief guards mCapacity, mEntries and mIndex
+	 */
+	mutex mMutex;
+	/**
+	 * @brief number of lookups which found an evaluation
+	 */
+	atomic<unsigned long long> mHits;
+	/**
+	 * @brief number of lookups
+	 */
+	atomic<unsigned long long> mLookups;
+};
+
+#endif
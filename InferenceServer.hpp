@@ -0,0 +1,286 @@
+/* Author: Hanuman Chu
+ *
+ * Creates templated InferenceServer class which collects game states submitted from any thread into batches and evaluates each batch
+ * with one call to a neural network or random playouts, where copies of an InferenceServer all submit to the same server
+ */
+#ifndef INFERENCE_SERVER_HPP
+#define INFERENCE_SERVER_HPP
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <future>
+#include <atomic>
+#include <chrono>
+#include <utility>
+#include <exception>
+using namespace std;
+
+#include "CancellationToken.h"
+
+const unsigned int SERVER_MAX_BATCH_SIZE = 64;
+const unsigned int SERVER_DEADLINE_MICROSECONDS = 500;
+
+template<typename E, typename U>
+class InferenceServer {
+public:
+	/**
+	 * @brief Constructs a new InferenceServer and starts the thread which evaluates its batches
+	 * @param EVALUATOR neural network or random playouts used to evaluate batches
+	 * @param MAX_BATCH_SIZE most game states evaluated together with a minimum of 1
+	 * @param DEADLINE_MICROSECONDS longest time the oldest waiting game state waits for the batch to fill before it is evaluated anyway
+	 */
+	InferenceServer(const E EVALUATOR, const unsigned int MAX_BATCH_SIZE = SERVER_MAX_BATCH_SIZE,
+		const unsigned int DEADLINE_MICROSECONDS = SERVER_DEADLINE_MICROSECONDS);
+
+	/**
+	 * @brief Queues given game state to be evaluated in the next batch
+	 * @param GAME_STATE game state to evaluate
+	 * @param CANCELLATION token checked when the game state would be put in a batch, which fails the future with SearchCancelled instead
+	 *        if it was cancelled
+	 * @return future which will hold the move probabilities and value of the game state
+	 */
+	future<pair<vector<float>, float>> submit(const U& GAME_STATE, const CancellationToken& CANCELLATION = CancellationToken());
+
+	/**
+	 * @brief Evaluates given game state in the next batch and waits for the result, which lets MCTS use the server as its leaf evaluator
+	 * @param GAME_STATE game state to evaluate
+	 * @return pair with the first element being the move probabilities and the second element being the value of the game state
+	 */
+	pair<vector<float>, float> predict(const U& GAME_STATE);
+
+	/**
+	 * @brief Queues all of given game states, which may be batched with game states from other threads, and waits for the results
+	 * @param GAME_STATES game states to evaluate
+	 * @param CANCELLATION token checked while waiting, which stops the wait within a millisecond and has the server drop the game states
+	 *        not yet in a batch
+	 * @return list of move probabilities and values in the same order as the game states
+	 * @throws SearchCancelled if the token was cancelled before every result arrived
+	 */
+	vector<pair<vector<float>, float>> predictBatch(const vector<U>& GAME_STATES, const CancellationToken& CANCELLATION = CancellationToken());
+
+	/**
+	 * @brief Returns the average number of game states in each batch evaluated so far
+	 * @return average batch size, 0 if nothing was evaluated
+	 */
+	float getAverageBatchSize() const;
+private:
+	/**
+	 * @brief Game state waiting to be evaluated
+	 */
+	struct Request {
+		/**
+		 * @brief game state to evaluate
+		 */
+		U gameState;
+		/**
+		 * @brief promise fulfilled with the evaluation
+		 */
+		promise<pair<vector<float>, float>> result;
+		/**
+		 * @brief time the game state was submitted
+		 */
+		chrono::steady_clock::time_point submitted;
+		/**
+		 * @brief token of the search which submitted the game state
+		 */
+		CancellationToken cancellation;
+	};
+
+	/**
+	 * @brief Everything shared by copies of one InferenceServer, which stops and joins the evaluation thread when the last copy is gone
+	 */
+	struct Server {
+		/**
+		 * @brief neural network or random playouts used to evaluate batches, only used by the evaluation thread
+		 */
+		E evaluator;
+		/**
+		 * @brief most game states evaluated together
+		 */
+		unsigned int maxBatchSize;
+		/**
+		 * @brief longest time the oldest waiting game state waits for the batch to fill
+		 */
+		chrono::microseconds deadline;
+		/**
+		 * @brief game states waiting to be evaluated in the order they were submitted
+		 */
+		deque<Request> requests;
+		/**
+		 * @brief guards requests and stopping
+		 */
+		mutex requestsMutex;
+		/**
+		 * @brief wakes the evaluation thread when game states are submitted or the server stops
+		 */
+		condition_variable requestsChanged;
+		/**
+		 * @brief whether the evaluation thread should finish the waiting game states and exit
+		 */
+		bool stopping;
+		/**
+		 * @brief number of batches evaluated
+		 */
+		atomic<unsigned long long> batches;
+		/**
+		 * @brief number of game states evaluated
+		 */
+		atomic<unsigned long long> evaluated;
+		/**
+		 * @brief thread which forms and evaluates batches
+		 */
+		thread evaluationThread;
+
+		/**
+		 * @brief Constructs the shared state of a server without starting its thread
+		 * @param EVALUATOR neural network or random playouts used to evaluate batches
+		 * @param MAX_BATCH_SIZE most game states evaluated together
+		 * @param DEADLINE longest time the oldest waiting game state waits for the batch to fill
+		 */
+		Server(const E EVALUATOR, const unsigned int MAX_BATCH_SIZE, const chrono::microseconds DEADLINE) :
+			evaluator(EVALUATOR), maxBatchSize(MAX_BATCH_SIZE), deadline(DEADLINE), stopping(false), batches(0), evaluated(0) {}
+
+		/**
+		 * @brief Stops the evaluation thread after it evaluates the game states still waiting
+		 */
+		~Server();
+
+		/**
+		 * @brief Forms batches from waiting game states and evaluates them until the server stops
+		 */
+		void run();
+	};
+
+	/**
+	 * @brief server shared by every copy
+	 */
+	shared_ptr<Server> mServer;
+};
+
+template<typename E, typename U>
+InferenceServer<E, U>::InferenceServer(const E EVALUATOR, const unsigned int MAX_BATCH_SIZE, const unsigned int DEADLINE_MICROSECONDS) :
+	mServer(make_shared<Server>(EVALUATOR, MAX_BATCH_SIZE < 1 ? 1 : MAX_BATCH_SIZE, chrono::microseconds(DEADLINE_MICROSECONDS))) {
+	mServer->evaluationThread = thread(&Server::run, mServer.get());
+}
+
+template<typename E, typename U>
+future<pair<vector<float>, float>> InferenceServer<E, U>::submit(const U& GAME_STATE, const CancellationToken& CANCELLATION) {
+	Request request;
+	request.gameState = GAME_STATE;
+	request.submitted = chrono::steady_clock::now();
+	request.cancellation = CANCELLATION;
+	future<pair<vector<float>, float>> result = request.result.get_future();
+
+	{
+		lock_guard<mutex> lock(mServer->requestsMutex);
+		mServer->requests.push_back(move(request));
+	}
+	mServer->requestsChanged.notify_one();
+
+	return result;
+}
+
+template<typename E, typename U>
+pair<vector<float>, float> InferenceServer<E, U>::predict(const U& GAME_STATE) {
+	return submit(GAME_STATE).get();
+}
+
+template<typename E, typename U>
+vector<pair<vector<float>, float>> InferenceServer<E, U>::predictBatch(const vector<U>& GAME_STATES, const CancellationToken& CANCELLATION) {
+	vector<future<pair<vector<float>, float>>> futures;
+	for (const U& GAME_STATE:GAME_STATES) {
+		futures.push_back(submit(GAME_STATE, CANCELLATION));
+	}
+
+	//Game states already in a batch are still evaluated, but the futures are given up on so a cancelled search does not wait for them
+	vector<pair<vector<float>, float>> results;
+	for (future<pair<vector<float>, float>>& result:futures) {
+		while (result.wait_for(chrono::milliseconds(1)) != future_status::ready) {
+			if (CANCELLATION.isCancelled()) {
+				throw SearchCancelled();
+			}
+		}
+		results.push_back(result.get());
+	}
+
+	return results;
+}
+
+template<typename E, typename U>
+float InferenceServer<E, U>::getAverageBatchSize() const {
+	unsigned long long batches = mServer->batches.load();
+	return batches == 0 ? 0.0f : (float)mServer->evaluated.load() / batches;
+}
+
+template<typename E, typename U>
+InferenceServer<E, U>::Server::~Server() {
+	{
+		lock_guard<mutex> lock(requestsMutex);
+		stopping = true;
+	}
+	requestsChanged.notify_one();
+	evaluationThread.join();
+}
+
+template<typename E, typename U>
+void InferenceServer<E, U>::Server::run() {
+	vector<Request> batch;
+	vector<U> gameStates;
+	while (true) {
+		{
+			unique_lock<mutex> lock(requestsMutex);
+			requestsChanged.wait(lock, [this]() { return stopping || !requests.empty(); });
+			if (requests.empty()) {
+				return;
+			}
+
+			//Waits for the batch to fill until the oldest game state has waited for the deadline
+			const chrono::steady_clock::time_point DEADLINE = requests.front().submitted + deadline;
+			requestsChanged.wait_until(lock, DEADLINE, [this]() { return stopping || requests.size() >= maxBatchSize; });
+
+			//Game states of cancelled searches are failed instead of taking up room in the batch
+			while (!requests.empty() && batch.size() < maxBatchSize) {
+				if (requests.front().cancellation.isCancelled()) {
+					requests.front().result.set_exception(make_exception_ptr(SearchCancelled()));
+				} else {
+					batch.push_back(move(requests.front()));
+				}
+				requests.pop_front();
+			}
+		}
+		if (batch.empty()) {
+			continue;
+		}
+
+		gameStates.clear();
+		for (const Request& REQUEST:batch) {
+			gameStates.push_back(REQUEST.gameState);
+		}
+
+		//Passes an exception from the evaluator on to everyone waiting on the batch instead of ending the thread
+		vector<pair<vector<float>, float>> results;
+		exception_ptr error;
+		try {
+			results = evaluator.predictBatch(gameStates);
+		} catch (...) {
+			error = current_exception();
+		}
+		for (unsigned int i=0;i<batch.size();i++) {
+			if (error) {
+				batch[i].result.set_exception(error);
+			} else {
+				batch[i].result.set_value(move(results.at(i)));
+			}
+		}
+
+		batches++;
+		evaluated += batch.size();
+		batch.clear();
+	}
+}
+
+#endif
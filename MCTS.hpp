@@ -1,31 +1,195 @@
 /* Author: Hanuman Chu
  *
- * Creates templated MCTS class which uses a version of MCTS modified to work with neural networks
+ * Creates templated MCTS class which uses a version of MCTS modified to work with neural networks or random playouts
  */
 #ifndef MCTS_HPP
 #define MCTS_HPP
 
-#include "NeuralNetwork.hpp"
-#include "StateInfo.h"
+#include "SearchTree.h"
+#include "Solver.hpp"
+#include "RandomPlayouts.hpp"
+#include "InferenceServer.hpp"
+#include "CancellationToken.h"
 
 #include <vector>
-#include <map>
+#include <cstdint>
+#include <climits>
+#include <cmath>
+#include <utility>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+#include <memory>
+#include <random>
+#include <chrono>
+#include <algorithm>
 using namespace std;
 
 const float EXPLORATION_PARAMETER = 1;
+const unsigned int SOLVER_EMPTY_CELLS = 16;
+const unsigned int EVALUATION_BATCH_SIZE = 16;
+const unsigned int SIMULATIONS_PER_BATCH_LEAF = 25;
+const float ROOT_NOISE_ALPHA = 0.3f;
+const float ROOT_NOISE_FRACTION = 0.25f;
+const size_t SEARCH_MEMORY_LIMIT = 1 << 28;
+const unsigned int EVICTION_DEPTH = 2;
+const unsigned int GUMBEL_SAMPLED_MOVES = 16;
+const float GUMBEL_VISIT_SCALE = 50;
+const float GUMBEL_VALUE_SCALE = 1;
+
+//Only declared so that MCTS with random playouts builds without libtorch, NeuralNetwork.hpp must be included to use a neural network
+template<typename T>
+class NeuralNetwork;
+
+/**
+ * @brief Picks what evaluates leaves for MCTS<T, U>, which is a NeuralNetwork<T> unless T is RandomPlayouts or an InferenceServer, and
+ *        how independent searches of root parallel mode get their own copy of it
+ */
+template<typename T>
+struct LeafEvaluator {
+	typedef NeuralNetwork<T> type;
+	
+	/**
+	 * @brief Returns a clone of a neural network with its own neural net, since copies share one neural net which runs one batch at a time
+	 * @param EVALUATOR neural network to clone
+	 * @return clone of the neural network
+	 */
+	static type copy(const type& EVALUATOR) {
+		return EVALUATOR.clone();
+	}
+	
+	/**
+	 * @brief Returns whether a clone still has the weights of the neural network it was cloned from
+	 * @param COPY clone of the neural network
+	 * @param EVALUATOR neural network it was cloned from
+	 * @return true if the weights are the same
+	 */
+	static bool isCurrent(const type& COPY, const type& EVALUATOR) {
+		return COPY.getVersion() == EVALUATOR.getVersion();
+	}
+};
+
+template<>
+struct LeafEvaluator<RandomPlayouts> {
+	typedef RandomPlayouts type;
+	
+	static type copy(const type& EVALUATOR) {
+		return EVALUATOR;
+	}
+	
+	static bool isCurrent(const type&, const type&) {
+		return true;
+	}
+};
+
+template<typename E, typename V>
+struct LeafEvaluator<InferenceServer<E, V>> {
+	typedef InferenceServer<E, V> type;
+	
+	//Copies submit to the same server, which already evaluates batches from every search together
+	static type copy(const type& EVALUATOR) {
+		return EVALUATOR;
+	}
+	
+	static bool isCurrent(const type&, const type&) {
+		return true;
+	}
+};
+
+/**
+ * @brief Statistics of a search read from the edges of its root, where values are O's expected score like every other value in MCTS and
+ *        moves which share an edge because their game states are symmetric all get the statistics of that edge
+ */
+struct SearchResult {
+	/**
+	 * @brief number of visits of each of the 81 moves
+	 */
+	vector<float> visits;
+	/**
+	 * @brief average value of the simulations through each move, 0 for moves without visits
+	 */
+	vector<float> values;
+	/**
+	 * @brief probability the leaf evaluator gave each move, normalized over valid moves
+	 */
+	vector<float> priors;
+	/**
+	 * @brief probabilities improved by the search, the softmax of each move's log probability plus its scaled value, where moves without
+	 *        visits use the value of the root, which is the policy target in Gumbel mode
+	 */
+	vector<float> improvedPolicy;
+	/**
+	 * @brief whether each of the 81 moves is proven to lose for the player to move
+	 */
+	vector<bool> lost;
+	/**
+	 * @brief move with the most visits, where the lowest such move is picked on ties, or the move left after sequential halving in Gumbel
+	 *        mode, where moves proven to lose are only picked if every move is, -1 if there are no valid moves
+	 */
+	int bestMove;
+	/**
+	 * @brief moves expected to be played from the root, found by following the most visited edge down the tree
+	 */
+	vector<int> principalVariation;
+	/**
+	 * @brief average value of every simulation through the root, including ones from earlier searches kept by advanceRoot
+	 */
+	float rootValue;
+	/**
+	 * @brief result of the root in the format of getEnd once it is proven, in which case the best move is a move proven to get it unless
+	 *        the root is lost for the player to move, 2 if the root is not proven
+	 */
+	unsigned int provenResult;
+	/**
+	 * @brief number of simulations run by this search
+	 */
+	unsigned int simulations;
+	/**
+	 * @brief simulations run per second by this search, each of which adds at most one node to the tree
+	 */
+	float nodesPerSecond;
+};
 
 template<typename T, typename U>
 class MCTS {
 public:
 	/**
-	 * @brief Constructs a new MCTS object with the given neural network and number of simulations with a minimum of 1
-	 * @param NN neural network used to predict probabilities and value of game states
+	 * @brief Constructs a new MCTS object with the given leaf evaluator and number of simulations with a minimum of 1
+	 * @param EVALUATOR neural network or random playouts used to predict probabilities and value of game states
 	 * @param SIMULATIONS number of simulations to run each time
 	 */
-	MCTS(NeuralNetwork<T> NN, const unsigned int SIMULATIONS);
+	MCTS(const typename LeafEvaluator<T>::type EVALUATOR, const unsigned int SIMULATIONS);
+	
+	/**
+	 * @brief Moves an MCTS object, stopping the pondering of both objects first
+	 * @param other MCTS object to move from
+	 */
+	MCTS(MCTS<T, U>&& other) = default;
+	
+	/**
+	 * @brief Moves an MCTS object into this one, stopping the pondering of both objects first
+	 * @param other MCTS object to move from
+	 * @return this MCTS object
+	 */
+	MCTS<T, U>& operator=(MCTS<T, U>&& other) = default;
+	
+	/**
+	 * @brief Stops pondering before the tree it searches is freed
+	 */
+	~MCTS();
+	
+	/**
+	 * @brief Runs simulations on given game state and returns the statistics of every move from it
+	 * @param BASE_GAME_STATE game state to start simulations on
+	 * @return statistics of the search
+	 */
+	SearchResult search(const U BASE_GAME_STATE);
 	
 	/**
-	 * @brief Runs simulations on given game state and returns move probabilities corresponding to the number of times each move was visited
+	 * @brief Runs simulations on given game state and returns move probabilities corresponding to the number of times each move was visited,
+	 *        or the improved policy in Gumbel mode
 	 * @param BASE_GAME_STATE game state to start simulations on
 	 * @return list of probabilities for each move
 	 */
@@ -44,194 +208,1777 @@ public:
 	 */
 	void setSimulations(const unsigned int SIMULATIONS);
 	
+	/**
+	 * @brief Sets a wall clock budget for each search, which then runs until the budget is used up instead of stopping after the number
+	 *        of simulations, where 0 bounds searches by the number of simulations again
+	 * @param MILLISECONDS milliseconds each search may take
+	 */
+	void setTimeLimit(const unsigned int MILLISECONDS);
+	
+	/**
+	 * @brief Ends the search running on another thread as soon as its root is expanded, after which it returns the best move found so far,
+	 *        does nothing if no search is running
+	 */
+	void stop();
+	
+	/**
+	 * @brief Returns the token which cancels the searches of this MCTS object from any thread, including pondering and the independent
+	 *        searches of root parallel mode, where a cancelled search drops the batch it has not evaluated yet and returns what it found
+	 *        within milliseconds even if its root is not expanded, leaving the tree as if the dropped simulations never ran, and every
+	 *        search returns straight away until the token is reset
+	 * @return copy of the token sharing its flag
+	 */
+	CancellationToken getCancellationToken() const;
+	
+	/**
+	 * @brief Keeps searching given game state on a background thread while the opponent thinks until stopPondering is called, so the
+	 *        subtree under the move they pick already has simulations when advanceRoot keeps it, where the number of simulations, time
+	 *        limit and early stopping are ignored and the search only ends by itself once the root is proven or the tree is full, any
+	 *        earlier pondering is stopped first
+	 * @param BASE_GAME_STATE game state the opponent is thinking on
+	 */
+	void ponder(const U BASE_GAME_STATE);
+	
+	/**
+	 * @brief Stops pondering and waits for its threads to finish, which every other method that searches or changes the tree or settings
+	 *        does first, does nothing if MCTS is not pondering
+	 */
+	void stopPondering();
+	
+	/**
+	 * @brief Returns whether a search started by ponder is running or was stopped without stopPondering being called
+	 * @return true if pondering, false otherwise
+	 */
+	bool isPondering() const;
+	
+	/**
+	 * @brief Sets whether a search ends early once the move with the most visits at the root cannot be overtaken with the simulations it
+	 *        has left, and whether it returns without running any simulations when only one move is valid or not proven to lose, which is
+	 *        on by default
+	 * @param EARLY_STOPPING whether searches can end early
+	 */
+	void setEarlyStopping(const bool EARLY_STOPPING);
+	
+	/**
+	 * @brief Sets whether moves leading to game states which are rotations or reflections of each other share one edge and whether leaves
+	 *        are evaluated in their canonical form, which resets the MCTS tree
+	 * @param USE_SYMMETRIES whether to share symmetric game states
+	 */
+	void setUseSymmetries(const bool USE_SYMMETRIES);
+	
+	/**
+	 * @brief Sets the number of empty cells below which leaves are solved exactly instead of being evaluated by the neural network, where 0
+	 *        turns the solver off
+	 * @param EMPTY_CELLS leaves with fewer playable empty cells than this are solved
+	 */
+	void setSolverThreshold(const unsigned int EMPTY_CELLS);
+	
+	/**
+	 * @brief Sets the number of leaves collected before they are evaluated together in one batch with a minimum of 1, where every leaf
+	 *        after the first is found with virtual losses on the paths to the earlier ones, so searches without a time limit collect at
+	 *        most one leaf for every SIMULATIONS_PER_BATCH_LEAF simulations to keep a small budget from being spread across the root
+	 * @param BATCH_SIZE maximum number of leaves in each batch
+	 */
+	void setBatchSize(const unsigned int BATCH_SIZE);
+	
+	/**
+	 * @brief Sets the number of threads searching the tree at the same time with a minimum of 1, where virtual losses keep them on
+	 *        different paths
+	 * @param THREADS number of threads to search with
+	 */
+	void setThreads(const unsigned int THREADS);
+	
+	/**
+	 * @brief Sets the number of independent trees searched on their own threads, each with Dirichlet noise from its own seed added to its
+	 *        root, whose root visits are summed into the result, where each tree runs an equal share of the simulations on one thread
+	 *        with its own clone of the neural network so their batches do not wait on each other, and 1 turns root parallel search off
+	 * @param TREES number of trees to search
+	 * @param SEED seed the noise of each tree is derived from
+	 */
+	void setRootTrees(const unsigned int TREES, const unsigned int SEED = 0);
+	
+	/**
+	 * @brief Sets whether the root picks moves by Gumbel top k sampling with sequential halving instead of by selection score, which samples
+	 *        moves by their probabilities with Gumbel noise, splits the simulations evenly between them and drops the worse half until one
+	 *        is left, getting more out of few simulations, while the rest of the tree still uses the selection score
+	 * @param USE_GUMBEL whether to use Gumbel mode
+	 * @param SAMPLED_MOVES number of moves sampled at the root with a minimum of 1
+	 */
+	void setGumbel(const bool USE_GUMBEL, const unsigned int SAMPLED_MOVES = GUMBEL_SAMPLED_MOVES);
+	
+	/**
+	 * @brief Sets the most bytes the MCTS tree may use, split evenly between the trees in root parallel mode, where 0 removes the limit,
+	 *        a full tree keeps searching without adding nodes and is compacted before the next search by dropping subtrees with few
+	 *        visits which are more than EVICTION_DEPTH moves from the root
+	 * @param BYTES most bytes the tree may use
+	 */
+	void setMemoryLimit(const size_t BYTES);
+	
+	/**
+	 * @brief Returns the number of nodes in the MCTS tree, summed over every tree in root parallel mode, which can be read during a search
+	 * @return number of nodes
+	 */
+	size_t getNodeCount() const;
+	
+	/**
+	 * @brief Returns the number of bytes used by the MCTS tree, summed over every tree in root parallel mode, which can be read during a
+	 *        search
+	 * @return bytes used
+	 */
+	size_t getBytesUsed() const;
+	
+	/**
+	 * @brief Keeps the subtree under the given move from the root as the new tree and frees everything else, so the next search on the
+	 *        resulting game state starts with the simulations already done there, where a move sharing an edge with symmetric moves keeps
+	 *        the subtree of that edge turned into its own frame, the tree is reset if the move was never searched, must not be called
+	 *        during a search
+	 * @param MOVE move played from the game state at the root
+	 * @throws invalid_argument if the move is not valid from the game state at the root
+	 */
+	void advanceRoot(const int MOVE);
+	
 	/**
 	 * @brief Resets MCTS tree
 	 */
 	void reset();
 private:
 	/**
-	 * @brief the neural network used to predict the value and move probabilities of game boards
+	 * @brief One edge taken on the way down to a leaf
+	 */
+	struct SearchStep {
+		/**
+		 * @brief node the edge leaves from
+		 */
+		SearchNode* node;
+		/**
+		 * @brief index of the edge
+		 */
+		unsigned int edge;
+		/**
+		 * @brief value added to the edge as a virtual loss for the player choosing it, replaced by the real value during backup
+		 */
+		float lostValue;
+		/**
+		 * @brief player choosing the edge
+		 */
+		unsigned int player;
+	};
+	
+	/**
+	 * @brief Leaf waiting for the rest of its batch to be evaluated
+	 */
+	struct PendingLeaf {
+		/**
+		 * @brief node of the leaf
+		 */
+		SearchNode* node;
+		/**
+		 * @brief game state of the leaf
+		 */
+		U gameState;
+		/**
+		 * @brief symmetry the leaf was evaluated in
+		 */
+		unsigned int symmetry;
+	};
+	
+	/**
+	 * @brief Sequential halving schedule of the root in Gumbel mode, which is set up when the root is first selected from in a search
 	 */
-	NeuralNetwork<T> mNN;
+	struct GumbelRoot {
+		/**
+		 * @brief whether the schedule was set up for the current search
+		 */
+		bool started = false;
+		/**
+		 * @brief Gumbel noise plus log probability of each edge
+		 */
+		vector<float> scores;
+		/**
+		 * @brief visits of each edge when the search started, since visits kept by advanceRoot do not count towards the schedule
+		 */
+		vector<unsigned int> startVisits;
+		/**
+		 * @brief edges still being considered
+		 */
+		vector<unsigned int> remaining;
+		/**
+		 * @brief visits from this search each remaining edge gets by the end of the current phase
+		 */
+		unsigned int phaseVisits = 0;
+		/**
+		 * @brief number of times the edges are halved
+		 */
+		unsigned int phases = 1;
+	};
+	
+	/**
+	 * @brief Background search started by ponder, which stops itself whenever it is moved or destroyed so the MCTS object it searches is
+	 *        never changed under it
+	 */
+	struct Ponder {
+		/**
+		 * @brief thread running the search, not joinable if MCTS is not pondering
+		 */
+		thread worker;
+		/**
+		 * @brief stop flag of the MCTS object being searched
+		 */
+		shared_ptr<atomic<bool>> stopRequested;
+		/**
+		 * @brief whether the running search is a ponder search, which independent searches of root parallel mode copy from their parent
+		 */
+		bool searching = false;
+		
+		/**
+		 * @brief Constructs a ponder which is not searching
+		 */
+		Ponder() = default;
+		
+		/**
+		 * @brief Stops the search of the ponder being moved from, which cannot go on once its MCTS object is moved
+		 * @param other ponder to move from
+		 */
+		Ponder(Ponder&& other) {
+			other.finish();
+		}
+		
+		/**
+		 * @brief Stops the searches of both ponders
+		 * @param other ponder to move from
+		 * @return this ponder
+		 */
+		Ponder& operator=(Ponder&& other) {
+			finish();
+			other.finish();
+			return *this;
+		}
+		
+		/**
+		 * @brief Stops the search
+		 */
+		~Ponder() {
+			finish();
+		}
+		
+		/**
+		 * @brief Stops the search and waits for it to end
+		 */
+		void finish() {
+			if (worker.joinable()) {
+				stopRequested->store(true);
+				worker.join();
+			}
+			searching = false;
+		}
+	};
+	
+	/**
+	 * @brief State shared by the threads of one search, which only lives as long as the search so MCTS stays movable
+	 */
+	struct SearchShared {
+		/**
+		 * @brief guards allocation from mArena
+		 */
+		mutex arenaMutex;
+		/**
+		 * @brief guards mSolver which has one transposition table
+		 */
+		mutex solverMutex;
+		/**
+		 * @brief guards mGumbelRoot
+		 */
+		mutex gumbelMutex;
+		/**
+		 * @brief guards waiting on expanded
+		 */
+		mutex expandedMutex;
+		/**
+		 * @brief wakes threads waiting for a leaf another thread is evaluating once a batch is expanded or given back
+		 */
+		condition_variable expanded;
+		/**
+		 * @brief number of simulations claimed by the threads so far
+		 */
+		atomic<unsigned int> simulations{0};
+		/**
+		 * @brief number of simulations backed up by the threads so far
+		 */
+		atomic<unsigned int> completed{0};
+		/**
+		 * @brief time the search has to end by if it has a time limit
+		 */
+		chrono::steady_clock::time_point deadline;
+	};
+	
+	/**
+	 * @brief background search started by ponder, declared first so moving into a pondering MCTS object stops the search before any other
+	 *        member changes
+	 */
+	Ponder mPonder;
+	/**
+	 * @brief the neural network or random playouts used to predict the value and move probabilities of game boards
+	 */
+	typename LeafEvaluator<T>::type mEvaluator;
 	/**
 	 * @brief the number of simulations to perform each time mMCTS is run
 	 */
 	unsigned int mSimulations;
 	/**
-	 * @brief maps game state keys to their state information
+	 * @brief milliseconds each search may take, 0 if searches are bounded by the number of simulations
+	 */
+	unsigned int mTimeLimit;
+	/**
+	 * @brief set to end the running search early, shared with the independent searches of root parallel mode and held by pointer so MCTS
+	 *        stays movable
+	 */
+	shared_ptr<atomic<bool>> mStopRequested;
+	/**
+	 * @brief cancels searches, shared with the independent searches of root parallel mode
+	 */
+	CancellationToken mCancellation;
+	/**
+	 * @brief whether a search ends once its best move is decided
+	 */
+	bool mEarlyStopping;
+	/**
+	 * @brief holds every node and edge of the MCTS tree so the tree is freed with one reset
+	 */
+	SearchArena mArena;
+	/**
+	 * @brief arena the kept subtree is copied into when advancing the root, swapped with mArena afterwards
+	 */
+	SearchArena mSpareArena;
+	/**
+	 * @brief most bytes the tree may use, 0 if there is no limit
+	 */
+	size_t mMemoryLimit;
+	/**
+	 * @brief number of nodes in the tree, held by pointer so MCTS stays movable
+	 */
+	unique_ptr<atomic<size_t>> mNodeCount;
+	/**
+	 * @brief node of the game state simulations start from, null if there is no tree
+	 */
+	SearchNode* mRoot;
+	/**
+	 * @brief game state at the root
+	 */
+	U mRootGameState;
+	/**
+	 * @brief whether symmetric children share an edge and leaves are evaluated in their canonical form
+	 */
+	bool mUseSymmetries;
+	/**
+	 * @brief solves late game states exactly
+	 */
+	Solver<U> mSolver;
+	/**
+	 * @brief leaves with fewer playable empty cells than this are solved, 0 if the solver is off
+	 */
+	unsigned int mSolverThreshold;
+	/**
+	 * @brief maximum number of leaves evaluated in one batch
+	 */
+	unsigned int mBatchSize;
+	/**
+	 * @brief number of threads searching the tree at the same time
+	 */
+	unsigned int mThreads;
+	/**
+	 * @brief independent searches run in root parallel mode, empty if it is off
+	 */
+	vector<unique_ptr<MCTS<T, U>>> mRootSearches;
+	/**
+	 * @brief whether Dirichlet noise is mixed into the probabilities of the root when it is expanded
+	 */
+	bool mRootNoise;
+	/**
+	 * @brief generates the Dirichlet noise and Gumbel noise for the root
+	 */
+	default_random_engine mNoiseGenerator;
+	/**
+	 * @brief whether the root picks moves by Gumbel top k sampling with sequential halving
+	 */
+	bool mGumbel;
+	/**
+	 * @brief number of moves sampled at the root in Gumbel mode
+	 */
+	unsigned int mGumbelMoves;
+	/**
+	 * @brief sequential halving schedule of the current search in Gumbel mode
+	 */
+	GumbelRoot mGumbelRoot;
+	
+	/**
+	 * @brief Returns the root node for given game state, replacing the tree if it was built for a different game state
+	 * @param BASE_GAME_STATE game state to start simulations on
+	 * @return root node
+	 */
+	SearchNode* mGetRoot(const U& BASE_GAME_STATE);
+	
+	/**
+	 * @brief Copies a node and everything below it into an arena, leaving out the subtrees of edges with fewer than the given number of
+	 *        visits once they are more than EVICTION_DEPTH moves below the node
+	 * @param NODE node to copy
+	 * @param arena arena to allocate the copy from
+	 * @param MIN_VISITS fewest visits an edge needs to keep its subtree when it is deep enough to be left out, 0 to copy everything
+	 * @param DEPTH number of moves the node is below the node the copy started from
+	 * @param SYMMETRY symmetry every move in the copy is sent through, keeping the edges of each node in the order of their moves, 0 to
+	 *        copy the moves unchanged
+	 * @param copiedNodes increased by the number of nodes copied
+	 * @return copy of the node
+	 */
+	SearchNode* mCopySubtree(const SearchNode* NODE, SearchArena& arena, const unsigned int MIN_VISITS, const unsigned int DEPTH,
+		const unsigned int SYMMETRY, size_t& copiedNodes) const;
+	
+	/**
+	 * @brief Returns whether the tree has used up its memory limit
+	 * @return true if there is a limit and the tree has reached it
 	 */
-	map<string, StateInfo> mStateInfos;
+	bool mMemoryFull() const;
 	
 	/**
-	 * @brief Recursively looks for unexplored game state using game state's selection score, simulates it, then updates values based on
-	 * @brief the simulation result
-	 * @param POTENTIAL_LEAF game state to simulate
-	 * @return final value of simulation
+	 * @brief Compacts the tree if it uses more than half of its memory limit, leaving out subtrees with few visits far from the root and
+	 *        raising the number of visits needed to be kept until it fits in half of the limit
 	 */
-	float mSimulate(const U POTENTIAL_LEAF);
+	void mEvict();
 	
 	/**
-	 * @brief Runs simulations on given game state
+	 * @brief Copies the settings into each independent search of root parallel mode, giving every search an equal share of the simulations,
+	 *        and clones the neural network again for any search whose clone is older than a later load or training
+	 */
+	void mConfigureRootSearches();
+	
+	/**
+	 * @brief Reads the statistics of each move from the edges of the root, combining every independent search in root parallel mode by
+	 *        summing visits and averaging values and probabilities, without the simulation count and speed which only the search knows
+	 * @param BASE_GAME_STATE game state at the root
+	 * @return statistics of the tree
+	 */
+	SearchResult mGetResult(const U& BASE_GAME_STATE) const;
+	
+	/**
+	 * @brief Gives the node of an evaluated leaf an edge for each valid move with the predicted probabilities
+	 * @param node node of the leaf
+	 * @param GAME_STATE game state of the leaf
+	 * @param SYMMETRY symmetry the leaf was evaluated in
+	 * @param RESULTS move probabilities and value predicted for the leaf in that symmetry
+	 * @param shared state shared by the threads of the search
+	 */
+	void mExpand(SearchNode* node, const U& GAME_STATE, const unsigned int SYMMETRY, const pair<vector<float>, float>& RESULTS, SearchShared& shared);
+	
+	/**
+	 * @brief Returns the edge with the highest selection score, skipping edges to proven game states since more simulations cannot change
+	 *        their value
+	 * @param NODE expanded node to select from
+	 * @param NEXT_PLAYER player making the move
+	 * @return index of the selected edge
+	 */
+	unsigned int mSelect(const SearchNode* NODE, const unsigned int NEXT_PLAYER) const;
+	
+	/**
+	 * @brief Returns the value of an edge from the view of the player choosing it scaled for Gumbel mode, which grows with the visits of the
+	 *        most visited edge so values count for more as they become more certain
+	 * @param NODE expanded node the edge leaves from
+	 * @param EDGE index of the edge
+	 * @param PLAYER player choosing the edge
+	 * @param MOST_VISITS visits of the most visited edge of the node
+	 * @param UNVISITED_VALUE value used if the edge has no visits, from the view of the player choosing it
+	 * @return scaled value
+	 */
+	static float mGumbelValue(const SearchNode* NODE, const unsigned int EDGE, const unsigned int PLAYER, const unsigned int MOST_VISITS,
+		const float UNVISITED_VALUE);
+	
+	/**
+	 * @brief Halves the remaining edges of the Gumbel schedule, keeping the ones with the highest score plus scaled value, and moves on to
+	 *        the next phase
+	 * @param ROOT expanded root node
+	 */
+	void mHalveGumbelRoot(const SearchNode* ROOT);
+	
+	/**
+	 * @brief Returns the remaining edge of the Gumbel schedule with the fewest visits this search which has not reached the visits of the
+	 *        current phase yet, halving the edges whenever all of them have, setting up the schedule if this is the first call of the search
+	 * @param ROOT expanded root node
+	 * @param shared state shared by the threads of the search
+	 * @return index of the selected edge, -1 if every remaining edge is proven so the selection score has to pick
+	 */
+	int mSelectGumbel(const SearchNode* ROOT, SearchShared& shared);
+	
+	/**
+	 * @brief Follows the selection score down from a node to a game state which is not expanded or is proven, adding a virtual loss to
+	 *        every edge taken
+	 * @param node node to start from
+	 * @param gameState game state of the starting node, moves are applied to it on the way down
+	 * @param path filled with the edges taken
+	 * @param shared state shared by the threads of the search
+	 * @return node of the game state which was reached, null if it has no node because the tree is out of memory
+	 */
+	SearchNode* mDescend(SearchNode* node, U& gameState, vector<SearchStep>& path, SearchShared& shared);
+	
+	/**
+	 * @brief Replaces the virtual losses along a path with the value of the simulation
+	 * @param PATH edges taken by the simulation
+	 * @param VALUE final value of simulation
+	 */
+	void mBackup(const vector<SearchStep>& PATH, const float VALUE);
+	
+	/**
+	 * @brief Marks the nodes along a path as proven from the bottom up for as long as their results follow from their children, where a
+	 *        node is won by the player to move if any child is, and otherwise is proven once every child is with the best of their results
+	 * @param PATH edges taken to a proven game state
+	 */
+	void mProve(const vector<SearchStep>& PATH);
+	
+	/**
+	 * @brief Returns the value of a proven result
+	 * @param PROVEN proven result in the format of getEnd
+	 * @return 0 if X wins, 1 if O wins, and 0.5 for a tie
+	 */
+	static float mProvenValue(const unsigned char PROVEN);
+	
+	/**
+	 * @brief Returns whether an edge leads to a game state proven to be lost by the player choosing it
+	 * @param NODE expanded node the edge leaves from
+	 * @param EDGE index of the edge
+	 * @param PLAYER player choosing the edge
+	 * @return true if the edge is proven to lose
+	 */
+	static bool mEdgeLost(const SearchNode* NODE, const unsigned int EDGE, const unsigned int PLAYER);
+	
+	/**
+	 * @brief Returns the first edge leading to a game state with the same proven result as the node, which is the move to play from a
+	 *        proven game state
+	 * @param NODE node to look at
+	 * @return index of the edge, -1 if the node is not proven or none of its expanded edges are proven to keep its result yet
+	 */
+	static int mProvenEdge(const SearchNode* NODE);
+	
+	/**
+	 * @brief Removes the virtual losses along a path without counting it as a simulation
+	 * @param PATH edges taken
+	 */
+	void mRevert(const vector<SearchStep>& PATH);
+	
+	/**
+	 * @brief Returns whether the move with the most visits at the root can no longer change, either because it is the only move not proven
+	 *        to lose or because it leads the second most visited such move by more visits than there are simulations left
+	 * @param ROOT expanded root node
+	 * @param CLAIMED number of simulations claimed so far
+	 * @return true if the best move is decided
+	 */
+	bool mBestMoveDecided(const SearchNode* ROOT, const unsigned int CLAIMED) const;
+	
+	/**
+	 * @brief Returns the move to play without searching, which is the only valid move or, if the tree already holds the game state, the
+	 *        only move at the root not proven to lose
 	 * @param BASE_GAME_STATE game state to start simulations on
+	 * @return forced move, -1 if there is a choice to make
+	 */
+	int mForcedMove(const U& BASE_GAME_STATE) const;
+	
+	/**
+	 * @brief Returns whether a search should stop claiming simulations, which it only does once the root is expanded so there is a move
+	 *        to return unless it was cancelled
+	 * @param ROOT root node
+	 * @param ROOT_ENDED whether the game state at the root is already over
+	 * @param shared state shared by the threads of the search
+	 * @return true if the search was cancelled or stopped, ran out of time, proved or decided its best move, or claimed all of its
+	 *         simulations, or for a ponder search only if it was cancelled or stopped, proved its root or filled the tree
 	 */
-	void mMCTS(const U BASE_GAME_STATE);
+	bool mSearchFinished(const SearchNode* ROOT, const bool ROOT_ENDED, SearchShared& shared);
+	
+	/**
+	 * @brief Runs simulations claimed from the shared count in batches until the search is finished, evaluating the leaves of each batch
+	 *        together
+	 * @param root root node
+	 * @param BASE_GAME_STATE game state at the root
+	 * @param shared state shared by the threads of the search
+	 */
+	void mRunWorker(SearchNode* root, const U& BASE_GAME_STATE, SearchShared& shared);
+	
+	/**
+	 * @brief Wakes the threads waiting for a leaf to be evaluated after a batch is expanded or given back
+	 * @param shared state shared by the threads of the search
+	 */
+	static void mNotifyExpanded(SearchShared& shared);
+	
+	/**
+	 * @brief Runs simulations on given game state with every thread
+	 * @param BASE_GAME_STATE game state to start simulations on
+	 * @return number of simulations run
+	 */
+	unsigned int mMCTS(const U BASE_GAME_STATE);
 };
 
 template<typename T, typename U>
-MCTS<T, U>::MCTS(NeuralNetwork<T> NN, const unsigned int SIMULATIONS) : mNN(NN) {
-	if (SIMULATIONS < 1) {
-		mSimulations = 1;
-	} else {
-		mSimulations = SIMULATIONS;
+MCTS<T, U>::MCTS(const typename LeafEvaluator<T>::type EVALUATOR, const unsigned int SIMULATIONS) : mEvaluator(EVALUATOR), mTimeLimit(0),
+	mStopRequested(make_shared<atomic<bool>>(false)), mEarlyStopping(true), mMemoryLimit(0),
+	mNodeCount(new atomic<size_t>(0)), mRoot(nullptr),
+	mUseSymmetries(false), mSolverThreshold(0), mBatchSize(1), mThreads(1),
+	mRootNoise(false), mGumbel(false), mGumbelMoves(GUMBEL_SAMPLED_MOVES) {
+	if (SIMULATIONS < 1) {
+		mSimulations = 1;
+	} else {
+		mSimulations = SIMULATIONS;
+	}
+}
+
+template<typename T, typename U>
+MCTS<T, U>::~MCTS() {
+	stopPondering();
+}
+
+template<typename T, typename U>
+SearchResult MCTS<T, U>::search(const U BASE_GAME_STATE) {
+	stopPondering();
+	mStopRequested->store(false);
+	
+	//A forced move is returned before any thread starts or the root is evaluated, keeping the tree so advanceRoot still follows it
+	const int FORCED_MOVE = mEarlyStopping ? mForcedMove(BASE_GAME_STATE) : -1;
+	if (FORCED_MOVE != -1) {
+		if (mRootSearches.empty()) {
+			mGetRoot(BASE_GAME_STATE);
+		}
+		for (unique_ptr<MCTS<T, U>>& search:mRootSearches) {
+			search->mGetRoot(BASE_GAME_STATE);
+		}
+		
+		SearchResult result = mGetResult(BASE_GAME_STATE);
+		result.bestMove = FORCED_MOVE;
+		if (BASE_GAME_STATE.getValidMoveCount() == 1) {
+			result.priors[FORCED_MOVE] = 1.0f;
+			result.improvedPolicy[FORCED_MOVE] = 1.0f;
+		}
+		return result;
+	}
+	
+	chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+	unsigned int simulations = mMCTS(BASE_GAME_STATE);
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+	
+	SearchResult result = mGetResult(BASE_GAME_STATE);
+	result.simulations = simulations;
+	result.nodesPerSecond = seconds > 0 ? (float)(simulations / seconds) : 0.0f;
+	
+	return result;
+}
+
+template<typename T, typename U>
+vector<float> MCTS<T, U>::getMoveProbs(const U BASE_GAME_STATE) {
+	//Sums move visits rather than using the simulation count since symmetric moves share visits
+	SearchResult result = search(BASE_GAME_STATE);
+	vector<float> newMoveProbs = mGumbel ? result.improvedPolicy : result.visits;
+	float totalVisits = 0.0f;
+	for (float visits:newMoveProbs) {
+		totalVisits += visits;
+	}
+	
+	//A search which ran no simulations, like one for a forced move, puts every bit of probability on the move it returns
+	if (totalVisits > 0.0f) {
+		for (float& prob:newMoveProbs) {
+			prob /= totalVisits;
+		}
+	} else if (result.bestMove != -1) {
+		newMoveProbs[result.bestMove] = 1.0f;
+	}
+	
+	return newMoveProbs;
+}
+
+template<typename T, typename U>
+vector<float> MCTS<T, U>::getBestMove(const U BASE_GAME_STATE) {
+	const int BEST_MOVE = search(BASE_GAME_STATE).bestMove;
+	
+	vector<float> newMoveProbs;
+	for (int move = 0; move < 81; move++) {
+		newMoveProbs.push_back(move == BEST_MOVE ? 1.0f : 0.0f);
+	}
+	
+	return newMoveProbs;
+}
+
+template<typename T, typename U>
+void MCTS<T, U>::setSimulations(const unsigned int SIMULATIONS) {
+    stopPondering();
+    if (SIMULATIONS < 1) {
+		mSimulations = 1;
+	} else {
+		mSimulations = SIMULATIONS;
+	}
+}
+
+template<typename T, typename U>
+void MCTS<T, U>::setTimeLimit(const unsigned int MILLISECONDS) {
+	stopPondering();
+	mTimeLimit = MILLISECONDS;
+}
+
+template<typename T, typename U>
+void MCTS<T, U>::stop() {
+	mStopRequested->store(true);
+}
+
+template<typename T, typename U>
+CancellationToken MCTS<T, U>::getCancellationToken() const {
+	return mCancellation;
+}
+
+template<typename T, typename U>
+void MCTS<T, U>::ponder(const U BASE_GAME_STATE) {
+	stopPondering();
+	if (BASE_GAME_STATE.getEnd() != 2) {
+		return;
+	}
+	
+	mStopRequested->store(false);
+	mPonder.stopRequested = mStopRequested;
+	mPonder.searching = true;
+	mPonder.worker = thread([this, BASE_GAME_STATE]() {
+		mMCTS(BASE_GAME_STATE);
+	});
+}
+
+template<typename T, typename U>
+void MCTS<T, U>::stopPondering() {
+	mPonder.finish();
+}
+
+template<typename T, typename U>
+bool MCTS<T, U>::isPondering() const {
+	return mPonder.worker.joinable();
+}
+
+template<typename T, typename U>
+void MCTS<T, U>::setEarlyStopping(const bool EARLY_STOPPING) {
+	stopPondering();
+	mEarlyStopping = EARLY_STOPPING;
+}
+
+template<typename T, typename U>
+void MCTS<T, U>::setUseSymmetries(const bool USE_SYMMETRIES) {
+	stopPondering();
+	mUseSymmetries = USE_SYMMETRIES;
+	mArena.reset();
+	mNodeCount->store(0);
+	mRoot = nullptr;
+}
+
+template<typename T, typename U>
+void MCTS<T, U>::setSolverThreshold(const unsigned int EMPTY_CELLS) {
+	stopPondering();
+	mSolverThreshold = EMPTY_CELLS;
+}
+
+template<typename T, typename U>
+void MCTS<T, U>::setBatchSize(const unsigned int BATCH_SIZE) {
+	stopPondering();
+	if (BATCH_SIZE < 1) {
+		mBatchSize = 1;
+	} else {
+		mBatchSize = BATCH_SIZE;
+	}
+}
+
+template<typename T, typename U>
+void MCTS<T, U>::setThreads(const unsigned int THREADS) {
+	stopPondering();
+	if (THREADS < 1) {
+		mThreads = 1;
+	} else {
+		mThreads = THREADS;
+	}
+}
+
+template<typename T, typename U>
+void MCTS<T, U>::setRootTrees(const unsigned int TREES, const unsigned int SEED) {
+	stopPondering();
+	mRootSearches.clear();
+	if (TREES <= 1) {
+		return;
+	}
+	
+	seed_seq seeds{SEED};
+	vector<unsigned int> treeSeeds(TREES);
+	seeds.generate(treeSeeds.begin(), treeSeeds.end());
+	for (unsigned int tree=0;tree<TREES;tree++) {
+		mRootSearches.emplace_back(new MCTS<T, U>(LeafEvaluator<T>::copy(mEvaluator), mSimulations));
+		mRootSearches.back()->mRootNoise = true;
+		mRootSearches.back()->mNoiseGenerator.seed(treeSeeds[tree]);
+		mRootSearches.back()->mStopRequested = mStopRequested;
+		mRootSearches.back()->mCancellation = mCancellation;
+	}
+}
+
+template<typename T, typename U>
+void MCTS<T, U>::setGumbel(const bool USE_GUMBEL, const unsigned int SAMPLED_MOVES) {
+	stopPondering();
+	mGumbel = USE_GUMBEL;
+	mGumbelMoves = SAMPLED_MOVES < 1 ? 1 : SAMPLED_MOVES;
+}
+
+template<typename T, typename U>
+void MCTS<T, U>::setMemoryLimit(const size_t BYTES) {
+	stopPondering();
+	mMemoryLimit = BYTES;
+}
+
+template<typename T, typename U>
+size_t MCTS<T, U>::getNodeCount() const {
+	size_t nodes = mNodeCount->load();
+	for (const unique_ptr<MCTS<T, U>>& SEARCH:mRootSearches) {
+		nodes += SEARCH->getNodeCount();
+	}
+	
+	return nodes;
+}
+
+template<typename T, typename U>
+size_t MCTS<T, U>::getBytesUsed() const {
+	size_t bytes = mArena.getBytesUsed();
+	for (const unique_ptr<MCTS<T, U>>& SEARCH:mRootSearches) {
+		bytes += SEARCH->getBytesUsed();
+	}
+	
+	return bytes;
+}
+
+template<typename T, typename U>
+void MCTS<T, U>::advanceRoot(const int MOVE) {
+	stopPondering();
+	for (unique_ptr<MCTS<T, U>>& search:mRootSearches) {
+		search->advanceRoot(MOVE);
+	}
+	
+	if (mRoot == nullptr) {
+		return;
+	}
+	
+	//With symmetries the edge may hold a different move leading to a symmetric game state, whose subtree is turned to match the move
+	const U CHILD_GAME_STATE = mRootGameState.getChild(MOVE);
+	const uint64_t CHILD_HASH = mUseSymmetries ? CHILD_GAME_STATE.getCanonicalHash() : 0;
+	SearchNode* child = nullptr;
+	unsigned int symmetry = 0;
+	for (unsigned int edge=0;edge<mRoot->edgeCount && child == nullptr;edge++) {
+		if (mRoot->moves[edge] == MOVE) {
+			child = mRoot->children[edge].load();
+		} else if (mUseSymmetries) {
+			const U EDGE_GAME_STATE = mRootGameState.getChild(mRoot->moves[edge]);
+			if (EDGE_GAME_STATE.getCanonicalHash() == CHILD_HASH) {
+				child = mRoot->children[edge].load();
+				while (symmetry < 7 && EDGE_GAME_STATE.getSymmetricHash(symmetry) != CHILD_GAME_STATE.getHash()) {
+					symmetry++;
+				}
+			}
+		}
+	}
+	mRootGameState = CHILD_GAME_STATE;
+	
+	if (child == nullptr) {
+		mArena.reset();
+		mNodeCount->store(0);
+		mRoot = nullptr;
+		return;
+	}
+	
+	//Copies the kept subtree into the spare arena and swaps them so everything unreachable is freed with one reset
+	size_t copiedNodes = 0;
+	mSpareArena.reset();
+	mRoot = mCopySubtree(child, mSpareArena, 0, 0, symmetry, copiedNodes);
+	swap(mArena, mSpareArena);
+	mSpareArena.reset();
+	mNodeCount->store(copiedNodes);
+	mEvict();
+}
+
+template<typename T, typename U>
+void MCTS<T, U>::reset() {
+    stopPondering();
+    mArena.reset();
+    mNodeCount->store(0);
+    mRoot = nullptr;
+    mSolver.clear();
+    for (unique_ptr<MCTS<T, U>>& search:mRootSearches) {
+        search->reset();
+    }
+}
+
+template<typename T, typename U>
+SearchNode* MCTS<T, U>::mGetRoot(const U& BASE_GAME_STATE) {
+	if (mRoot == nullptr || mRootGameState.getHash() != BASE_GAME_STATE.getHash()) {
+		mArena.reset();
+		mRoot = mArena.allocate<SearchNode>(1);
+		mNodeCount->store(1);
+		mRootGameState = BASE_GAME_STATE;
 	}
+	
+	return mRoot;
 }
 
 template<typename T, typename U>
-vector<float> MCTS<T, U>::getMoveProbs(const U BASE_GAME_STATE) {
-	mMCTS(BASE_GAME_STATE);
+SearchNode* MCTS<T, U>::mCopySubtree(const SearchNode* NODE, SearchArena& arena, const unsigned int MIN_VISITS, const unsigned int DEPTH,
+	const unsigned int SYMMETRY, size_t& copiedNodes) const {
+	SearchNode* copy = arena.allocate<SearchNode>(1);
+	copiedNodes++;
+	copy->simulations.store(NODE->simulations.load());
+	copy->proven.store(NODE->proven.load());
+	if (NODE->state.load() != NODE_EXPANDED) {
+		return copy;
+	}
+	
+	copy->edgeCount = NODE->edgeCount;
+	copy->moves = arena.allocate<unsigned char>(NODE->edgeCount);
+	copy->priors = arena.allocate<float>(NODE->edgeCount);
+	copy->visits = arena.allocate<atomic<unsigned int>>(NODE->edgeCount);
+	copy->totalValues = arena.allocate<atomic<float>>(NODE->edgeCount);
+	copy->children = arena.allocate<atomic<SearchNode*>>(NODE->edgeCount);
 	
-	float totalSimulations = 1.0f;
-	if (mStateInfos.find(BASE_GAME_STATE.getKey()) != mStateInfos.end()) {
-		totalSimulations = mStateInfos.at(BASE_GAME_STATE.getKey()).simulations;
+	//Edges are kept in the order of their moves after the symmetry, like the edges of a node expanded in that frame
+	unsigned int order[81];
+	for (unsigned int edge=0;edge<NODE->edgeCount;edge++) {
+		unsigned int position = edge;
+		while (position > 0 && U::getSymmetricMove(NODE->moves[order[position - 1]], SYMMETRY) > U::getSymmetricMove(NODE->moves[edge], SYMMETRY)) {
+			order[position] = order[position - 1];
+			position--;
+		}
+		order[position] = edge;
 	}
 	
-	vector<float> newMoveProbs;
-	for (int move = 0; move < 81; move++) {
-		if (BASE_GAME_STATE.isValid(move) && mStateInfos.find(BASE_GAME_STATE.getChild(move).getKey()) != mStateInfos.end()) {
-			newMoveProbs.push_back(mStateInfos.at(BASE_GAME_STATE.getChild(move).getKey()).visits / totalSimulations);
-		} else {
-			newMoveProbs.push_back(0.0f);
+	for (unsigned int copyEdge=0;copyEdge<NODE->edgeCount;copyEdge++) {
+		const unsigned int EDGE = order[copyEdge];
+		copy->moves[copyEdge] = (unsigned char)U::getSymmetricMove(NODE->moves[EDGE], SYMMETRY);
+		copy->priors[copyEdge] = NODE->priors[EDGE];
+		copy->visits[copyEdge].store(NODE->visits[EDGE].load());
+		copy->totalValues[copyEdge].store(NODE->totalValues[EDGE].load());
+		//The edge keeps its statistics when its subtree is left out so the search still knows how good the move was
+		bool kept = DEPTH < EVICTION_DEPTH || NODE->visits[EDGE].load() >= MIN_VISITS;
+		if (NODE->children[EDGE].load() != nullptr && kept) {
+			copy->children[copyEdge].store(mCopySubtree(NODE->children[EDGE].load(), arena, MIN_VISITS, DEPTH + 1, SYMMETRY, copiedNodes));
 		}
 	}
+	copy->state.store(NODE_EXPANDED);
 	
-	return newMoveProbs;
+	return copy;
 }
 
 template<typename T, typename U>
-vector<float> MCTS<T, U>::getBestMove(const U BASE_GAME_STATE) {
-	mMCTS(BASE_GAME_STATE);
+bool MCTS<T, U>::mMemoryFull() const {
+	return mMemoryLimit > 0 && mArena.getBytesUsed() >= mMemoryLimit;
+}
+
+template<typename T, typename U>
+void MCTS<T, U>::mEvict() {
+	if (mMemoryLimit == 0 || mRoot == nullptr || mArena.getBytesUsed() <= mMemoryLimit / 2) {
+		return;
+	}
 	
-	int mostVisited = -1;
-	int mostVisits = -1;
-	for (int move:BASE_GAME_STATE.getValidMoves()) {
-		if (mStateInfos.find(BASE_GAME_STATE.getChild(move).getKey()) == mStateInfos.end()) {
-			continue;
+	//Each try leaves out more of the tree until the copy fits, which at worst keeps only the first EVICTION_DEPTH moves
+	size_t copiedNodes = 0;
+	unsigned int minVisits = 2;
+	while (true) {
+		copiedNodes = 0;
+		mSpareArena.reset();
+		SearchNode* root = mCopySubtree(mRoot, mSpareArena, minVisits, 0, 0, copiedNodes);
+		if (mSpareArena.getBytesUsed() <= mMemoryLimit / 2 || minVisits > mRoot->simulations.load()) {
+			mRoot = root;
+			break;
+		}
+		minVisits *= 2;
+	}
+	
+	swap(mArena, mSpareArena);
+	mSpareArena.reset();
+	mNodeCount->store(copiedNodes);
+}
+
+template<typename T, typename U>
+void MCTS<T, U>::mConfigureRootSearches() {
+	const unsigned int TREES = mRootSearches.size();
+	for (unique_ptr<MCTS<T, U>>& search:mRootSearches) {
+		if (!LeafEvaluator<T>::isCurrent(search->mEvaluator, mEvaluator)) {
+			search->mEvaluator = LeafEvaluator<T>::copy(mEvaluator);
+		}
+		search->setSimulations((mSimulations + TREES - 1) / TREES);
+		search->setTimeLimit(mTimeLimit);
+		search->setEarlyStopping(mEarlyStopping);
+		search->setMemoryLimit(mMemoryLimit / TREES);
+		search->setGumbel(mGumbel, mGumbelMoves);
+		search->setSolverThreshold(mSolverThreshold);
+		search->setBatchSize(mBatchSize);
+		if (search->mUseSymmetries != mUseSymmetries) {
+			search->setUseSymmetries(mUseSymmetries);
+		}
+		//Set last since the setters above stop any pondering of the search
+		search->mPonder.searching = mPonder.searching;
+	}
+}
+
+template<typename T, typename U>
+SearchResult MCTS<T, U>::mGetResult(const U& BASE_GAME_STATE) const {
+	SearchResult result;
+	result.visits.assign(81, 0.0f);
+	result.values.assign(81, 0.0f);
+	result.priors.assign(81, 0.0f);
+	result.improvedPolicy.assign(81, 0.0f);
+	result.lost.assign(81, false);
+	result.bestMove = -1;
+	result.rootValue = 0.5f;
+	result.provenResult = NODE_UNPROVEN;
+	result.simulations = 0;
+	result.nodesPerSecond = 0.0f;
+	
+	if (!mRootSearches.empty()) {
+		vector<SearchResult> searchResults;
+		float totalValue = 0.0f, totalVisits = 0.0f;
+		for (const unique_ptr<MCTS<T, U>>& SEARCH:mRootSearches) {
+			searchResults.push_back(SEARCH->mGetResult(BASE_GAME_STATE));
+			float searchVisits = 0.0f;
+			for (unsigned int move=0;move<81;move++) {
+				const SearchResult& SEARCH_RESULT = searchResults.back();
+				result.visits[move] += SEARCH_RESULT.visits[move];
+				result.values[move] += SEARCH_RESULT.values[move] * SEARCH_RESULT.visits[move];
+				result.priors[move] += SEARCH_RESULT.priors[move] / mRootSearches.size();
+				result.improvedPolicy[move] += SEARCH_RESULT.improvedPolicy[move] / mRootSearches.size();
+				result.lost[move] = result.lost[move] || SEARCH_RESULT.lost[move];
+				searchVisits += SEARCH_RESULT.visits[move];
+			}
+			totalValue += searchResults.back().rootValue * searchVisits;
+			totalVisits += searchVisits;
+		}
+		for (unsigned int move=0;move<81;move++) {
+			if (result.visits[move] > 0.0f) {
+				result.values[move] /= result.visits[move];
+			}
+		}
+		if (totalVisits > 0.0f) {
+			result.rootValue = totalValue / totalVisits;
 		}
 		
-		int visits = mStateInfos.at(BASE_GAME_STATE.getChild(move).getKey()).visits;
-		if (visits > mostVisits) {
-			mostVisits = visits;
-			mostVisited = move;
+		//Each tree halves its own sample of moves so the improved policy is compared instead of visits in Gumbel mode, where a move one
+		//tree proved to lose is only picked if every move is, however many visits the other trees gave it
+		const vector<float>& SCORES = mGumbel ? result.improvedPolicy : result.visits;
+		for (int move:BASE_GAME_STATE.getValidMoves()) {
+			if (result.bestMove == -1 || (result.lost[result.bestMove] && !result.lost[move]) ||
+				(result.lost[result.bestMove] == result.lost[move] && SCORES[move] > SCORES[result.bestMove])) {
+				result.bestMove = move;
+			}
+		}
+		
+		//Every tree which proved the root proved the same result so the first one picks the move, unless the root is lost and the move
+		//with the most visits is kept
+		for (const SearchResult& SEARCH_RESULT:searchResults) {
+			if (SEARCH_RESULT.provenResult != NODE_UNPROVEN) {
+				result.provenResult = SEARCH_RESULT.provenResult;
+				result.rootValue = SEARCH_RESULT.rootValue;
+				if (SEARCH_RESULT.provenResult != 1 - BASE_GAME_STATE.getNextPlayer()) {
+					result.bestMove = SEARCH_RESULT.bestMove;
+				}
+				break;
+			}
+		}
+		
+		//Takes the line from the tree which looked at the best move the most
+		const SearchResult* deepest = nullptr;
+		for (const SearchResult& SEARCH_RESULT:searchResults) {
+			if (result.bestMove != -1 && (deepest == nullptr || SEARCH_RESULT.visits[result.bestMove] > deepest->visits[result.bestMove])) {
+				deepest = &SEARCH_RESULT;
+			}
+		}
+		if (deepest != nullptr && !deepest->principalVariation.empty() && deepest->principalVariation.front() == result.bestMove) {
+			result.principalVariation = deepest->principalVariation;
 		}
+		
+		return result;
 	}
 	
-	vector<float> newMoveProbs;
-	for (int move = 0; move < 81; move++) {
-		newMoveProbs.push_back(move == mostVisited ? 1.0f : 0.0f);
+	//A search cancelled before its root was evaluated has no statistics to give
+	if (mRoot == nullptr || mRoot->state.load() != NODE_EXPANDED) {
+		if (BASE_GAME_STATE.getValidMoveCount() > 0) {
+			result.bestMove = BASE_GAME_STATE.getValidMove(0);
+		}
+		return result;
 	}
 	
-	return newMoveProbs;
+	float totalValue = 0.0f, totalVisits = 0.0f;
+	bool bestLost = false;
+	for (unsigned int edge=0;edge<mRoot->edgeCount;edge++) {
+		const unsigned int MOVE = mRoot->moves[edge];
+		const float VISITS = (float)mRoot->visits[edge].load();
+		const float TOTAL_VALUE = mRoot->totalValues[edge].load();
+		result.visits[MOVE] = VISITS;
+		result.values[MOVE] = VISITS > 0.0f ? TOTAL_VALUE / VISITS : 0.0f;
+		result.priors[MOVE] = mRoot->priors[edge];
+		totalValue += TOTAL_VALUE;
+		totalVisits += VISITS;
+		
+		//Edges are in the order of the valid moves so the first edge with the most visits holds the lowest best move, where moves proven
+		//to lose are only picked if every move is
+		const bool LOST = mEdgeLost(mRoot, edge, BASE_GAME_STATE.getNextPlayer());
+		result.lost[MOVE] = LOST;
+		if (result.bestMove == -1 || (bestLost && !LOST) || (bestLost == LOST && VISITS > result.visits[result.bestMove])) {
+			result.bestMove = MOVE;
+			bestLost = LOST;
+		}
+	}
+	if (totalVisits > 0.0f) {
+		result.rootValue = totalValue / totalVisits;
+	}
+	
+	//Moves without visits are completed with the value of the root before the softmax
+	const unsigned int PLAYER = BASE_GAME_STATE.getNextPlayer();
+	unsigned int mostVisits = 0;
+	for (unsigned int edge=0;edge<mRoot->edgeCount;edge++) {
+		mostVisits = max(mostVisits, mRoot->visits[edge].load());
+	}
+	const float ROOT_VALUE = PLAYER == 0 ? 1 - result.rootValue : result.rootValue;
+	float logits[81];
+	float mostLogit = -INFINITY, totalPolicy = 0.0f;
+	for (unsigned int edge=0;edge<mRoot->edgeCount;edge++) {
+		logits[edge] = log(mRoot->priors[edge] + 1e-8f) + mGumbelValue(mRoot, edge, PLAYER, mostVisits, ROOT_VALUE);
+		mostLogit = max(mostLogit, logits[edge]);
+	}
+	for (unsigned int edge=0;edge<mRoot->edgeCount;edge++) {
+		result.improvedPolicy[mRoot->moves[edge]] = exp(logits[edge] - mostLogit);
+		totalPolicy += result.improvedPolicy[mRoot->moves[edge]];
+	}
+	for (unsigned int edge=0;edge<mRoot->edgeCount;edge++) {
+		result.improvedPolicy[mRoot->moves[edge]] /= totalPolicy;
+	}
+	
+	//Sequential halving picks the move left at the end, or the best of the remaining moves if the search ended before that
+	if (mGumbel && mGumbelRoot.started && mGumbelRoot.scores.size() == mRoot->edgeCount) {
+		float bestScore = -INFINITY;
+		for (unsigned int edge:mGumbelRoot.remaining) {
+			float score = mGumbelRoot.scores[edge] + mGumbelValue(mRoot, edge, PLAYER, mostVisits, ROOT_VALUE);
+			if (!mEdgeLost(mRoot, edge, PLAYER) && score > bestScore) {
+				bestScore = score;
+				result.bestMove = mRoot->moves[edge];
+			}
+		}
+	}
+	
+	//A move proven to keep the result of a proven root is played even if another move has more visits, except when every move loses and
+	//the most visited one already picked is the one most likely to trip up the opponent
+	const int PROVEN_EDGE = mProvenEdge(mRoot);
+	if (PROVEN_EDGE != -1) {
+		result.provenResult = mRoot->proven.load();
+		result.rootValue = mProvenValue(result.provenResult);
+		if (result.provenResult != 1 - PLAYER) {
+			result.bestMove = mRoot->moves[PROVEN_EDGE];
+		}
+	}
+	
+	if (mUseSymmetries) {
+		uint64_t edgeHashes[81];
+		for (unsigned int edge=0;edge<mRoot->edgeCount;edge++) {
+			edgeHashes[edge] = BASE_GAME_STATE.getChild(mRoot->moves[edge]).getCanonicalHash();
+		}
+		
+		for (int move:BASE_GAME_STATE.getValidMoves()) {
+			uint64_t childHash = BASE_GAME_STATE.getChild(move).getCanonicalHash();
+			for (unsigned int edge=0;edge<mRoot->edgeCount;edge++) {
+				if (edgeHashes[edge] == childHash) {
+					result.visits.at(move) = result.visits[mRoot->moves[edge]];
+					result.values.at(move) = result.values[mRoot->moves[edge]];
+					result.priors.at(move) = result.priors[mRoot->moves[edge]];
+					result.improvedPolicy.at(move) = result.improvedPolicy[mRoot->moves[edge]];
+					result.lost.at(move) = result.lost[mRoot->moves[edge]];
+					break;
+				}
+			}
+		}
+	}
+	
+	const SearchNode* node = mRoot;
+	while (node != nullptr && node->state.load() == NODE_EXPANDED) {
+		unsigned int bestEdge = 0;
+		for (unsigned int edge=1;edge<node->edgeCount;edge++) {
+			if (node->visits[edge].load() > node->visits[bestEdge].load()) {
+				bestEdge = edge;
+			}
+		}
+		if (node->edgeCount == 0 || node->visits[bestEdge].load() == 0) {
+			break;
+		}
+		
+		result.principalVariation.push_back(node->moves[bestEdge]);
+		node = node->children[bestEdge].load();
+	}
+	
+	return result;
 }
 
 template<typename T, typename U>
-void MCTS<T, U>::setSimulations(const unsigned int SIMULATIONS) {
-    if (SIMULATIONS < 1) {
-		mSimulations = 1;
-	} else {
-		mSimulations = SIMULATIONS;
+void MCTS<T, U>::mExpand(SearchNode* node, const U& GAME_STATE, const unsigned int SYMMETRY, const pair<vector<float>, float>& RESULTS, SearchShared& shared) {
+	auto moves = GAME_STATE.getValidMoves();
+	{
+		lock_guard<mutex> lock(shared.arenaMutex);
+		//A full tree leaves the node unexpanded so it is evaluated again next time, but the root is always expanded to have moves
+		if (node != mRoot && mMemoryFull()) {
+			node->state.store(NODE_UNEXPANDED, memory_order_release);
+			return;
+		}
+		node->moves = mArena.allocate<unsigned char>(moves.size());
+		node->priors = mArena.allocate<float>(moves.size());
+		node->visits = mArena.allocate<atomic<unsigned int>>(moves.size());
+		node->totalValues = mArena.allocate<atomic<float>>(moves.size());
+		node->children = mArena.allocate<atomic<SearchNode*>>(moves.size());
+	}
+	
+	float total = 0.0f;
+	uint64_t edgeHashes[81];
+	unsigned int edgeCount = 0;
+	for (int move:moves) {
+		//Move probabilities come from the evaluated symmetry so moves are sent through it before looking them up
+		float prior = RESULTS.first.at(U::getSymmetricMove(move, SYMMETRY));
+		total += prior;
+		
+		//Children which are symmetric to each other are the same game state, so they share one edge holding all of their probability
+		if (mUseSymmetries) {
+			uint64_t childHash = GAME_STATE.getChild(move).getCanonicalHash();
+			unsigned int edge = 0;
+			while (edge < edgeCount && edgeHashes[edge] != childHash) {
+				edge++;
+			}
+			if (edge < edgeCount) {
+				node->priors[edge] += prior;
+				continue;
+			}
+			edgeHashes[edgeCount] = childHash;
+		}
+		
+		node->moves[edgeCount] = (unsigned char)move;
+		node->priors[edgeCount] = prior;
+		edgeCount++;
+	}
+	
+	for (unsigned int edge=0;edge<edgeCount;edge++) {
+		node->priors[edge] /= total;
+	}
+	node->edgeCount = edgeCount;
+	
+	//Only one thread ever expands the root so the noise generator is not shared
+	if (mRootNoise && node == mRoot) {
+		gamma_distribution<float> gamma(ROOT_NOISE_ALPHA, 1.0f);
+		float noise[81];
+		float noiseTotal = 0.0f;
+		for (unsigned int edge=0;edge<edgeCount;edge++) {
+			noise[edge] = gamma(mNoiseGenerator);
+			noiseTotal += noise[edge];
+		}
+		for (unsigned int edge=0;edge<edgeCount && noiseTotal > 0.0f;edge++) {
+			node->priors[edge] = (1 - ROOT_NOISE_FRACTION) * node->priors[edge] + ROOT_NOISE_FRACTION * noise[edge] / noiseTotal;
+		}
 	}
+	
+	//Publishes the edges, so they must all be written before this
+	node->state.store(NODE_EXPANDED, memory_order_release);
 }
 
 template<typename T, typename U>
-void MCTS<T, U>::reset() {
-    mStateInfos.clear();
+unsigned int MCTS<T, U>::mSelect(const SearchNode* NODE, const unsigned int NEXT_PLAYER) const {
+	float bestSelectionScore = -1.0f;
+	unsigned int bestSelection = 0;
+	const float SIMULATIONS = (float)NODE->simulations.load(memory_order_relaxed);
+	for (unsigned int edge=0;edge<NODE->edgeCount;edge++) {
+		const SearchNode* CHILD = NODE->children[edge].load(memory_order_acquire);
+		if (CHILD != nullptr && CHILD->proven.load(memory_order_relaxed) != NODE_UNPROVEN) {
+			continue;
+		}
+		
+		float selectionScore;
+		unsigned int visits = NODE->visits[edge].load(memory_order_relaxed);
+		if (visits > 0) {
+			float childValue = NODE->totalValues[edge].load(memory_order_relaxed) / visits;
+			if (NEXT_PLAYER == 0) {
+				childValue = 1 - childValue;
+			}
+			
+			selectionScore = childValue + EXPLORATION_PARAMETER * NODE->priors[edge] * sqrt(SIMULATIONS) / (visits + 1);
+		} else {
+			selectionScore = 0.5f + EXPLORATION_PARAMETER * NODE->priors[edge] * sqrt(SIMULATIONS + 0.00000001f);
+		}
+		
+		if (selectionScore > bestSelectionScore) {
+			bestSelectionScore = selectionScore;
+			bestSelection = edge;
+		}
+	}
+	
+	return bestSelection;
 }
 
-
 template<typename T, typename U>
-float MCTS<T, U>::mSimulate(const U POTENTIAL_LEAF) {
-	if (POTENTIAL_LEAF.getEnd() != 2) {
-		if (POTENTIAL_LEAF.getEnd() == 3) {
-			return 0.5f;
-		} else {
-			return POTENTIAL_LEAF.getEnd();
+float MCTS<T, U>::mGumbelValue(const SearchNode* NODE, const unsigned int EDGE, const unsigned int PLAYER, const unsigned int MOST_VISITS,
+	const float UNVISITED_VALUE) {
+	float value = UNVISITED_VALUE;
+	unsigned int visits = NODE->visits[EDGE].load(memory_order_relaxed);
+	if (visits > 0) {
+		value = NODE->totalValues[EDGE].load(memory_order_relaxed) / visits;
+		if (PLAYER == 0) {
+			value = 1 - value;
 		}
 	}
 	
-	map<string, StateInfo>::iterator leafStateInfoIter = mStateInfos.find(POTENTIAL_LEAF.getKey());
+	return (GUMBEL_VISIT_SCALE + MOST_VISITS) * GUMBEL_VALUE_SCALE * value;
+}
+
+template<typename T, typename U>
+void MCTS<T, U>::mHalveGumbelRoot(const SearchNode* ROOT) {
+	vector<unsigned int>& remaining = mGumbelRoot.remaining;
+	if (remaining.size() > 1) {
+		const unsigned int PLAYER = mRootGameState.getNextPlayer();
+		unsigned int mostVisits = 0;
+		for (unsigned int edge=0;edge<ROOT->edgeCount;edge++) {
+			mostVisits = max(mostVisits, ROOT->visits[edge].load(memory_order_relaxed));
+		}
+		
+		vector<float> scores(ROOT->edgeCount);
+		for (unsigned int edge:remaining) {
+			scores[edge] = mGumbelRoot.scores[edge] + mGumbelValue(ROOT, edge, PLAYER, mostVisits, 0.0f);
+		}
+		stable_sort(remaining.begin(), remaining.end(), [&scores](const unsigned int FIRST, const unsigned int SECOND) {
+			return scores[FIRST] > scores[SECOND];
+		});
+		remaining.resize((remaining.size() + 1) / 2);
+	}
 	
-	if (leafStateInfoIter == mStateInfos.end()) {
-		//Evaluates leaf
-		pair<vector<float>, float> results = mNN.predict(POTENTIAL_LEAF.getBoard());
+	//The last move left takes every simulation still to come
+	if (remaining.size() == 1) {
+		mGumbelRoot.phaseVisits = UINT_MAX;
+	} else {
+		mGumbelRoot.phaseVisits += max(1u, mSimulations / (mGumbelRoot.phases * (unsigned int)remaining.size()));
+	}
+}
+
+template<typename T, typename U>
+int MCTS<T, U>::mSelectGumbel(const SearchNode* ROOT, SearchShared& shared) {
+	lock_guard<mutex> lock(shared.gumbelMutex);
+	GumbelRoot& gumbelRoot = mGumbelRoot;
+	if (!gumbelRoot.started) {
+		extreme_value_distribution<float> gumbel(0.0f, 1.0f);
+		gumbelRoot.scores.resize(ROOT->edgeCount);
+		gumbelRoot.startVisits.resize(ROOT->edgeCount);
+		gumbelRoot.remaining.clear();
+		for (unsigned int edge=0;edge<ROOT->edgeCount;edge++) {
+			gumbelRoot.scores[edge] = gumbel(mNoiseGenerator) + log(ROOT->priors[edge] + 1e-8f);
+			gumbelRoot.startVisits[edge] = ROOT->visits[edge].load(memory_order_relaxed);
+			gumbelRoot.remaining.push_back(edge);
+		}
 		
-		float total = 0.0f;
-		for (int move:POTENTIAL_LEAF.getValidMoves()) {
-			total += results.first.at(move);
+		//Sampling the moves with the highest noisy log probabilities is the same as sampling without replacement by probability
+		stable_sort(gumbelRoot.remaining.begin(), gumbelRoot.remaining.end(), [&gumbelRoot](const unsigned int FIRST, const unsigned int SECOND) {
+			return gumbelRoot.scores[FIRST] > gumbelRoot.scores[SECOND];
+		});
+		//Sampling more moves than there are simulations leaves moves which are never visited
+		const unsigned int SAMPLED_MOVES = mTimeLimit == 0 ? max(1u, min(mGumbelMoves, mSimulations)) : mGumbelMoves;
+		gumbelRoot.remaining.resize(min((unsigned int)gumbelRoot.remaining.size(), SAMPLED_MOVES));
+		gumbelRoot.phases = max(1u, (unsigned int)ceil(log2((float)gumbelRoot.remaining.size())));
+		gumbelRoot.phaseVisits = gumbelRoot.remaining.size() == 1 ? UINT_MAX :
+			max(1u, mSimulations / (gumbelRoot.phases * (unsigned int)gumbelRoot.remaining.size()));
+		gumbelRoot.started = true;
+	}
+	
+	while (true) {
+		int selection = -1;
+		unsigned int fewestVisits = 0;
+		bool open = false;
+		for (unsigned int edge:gumbelRoot.remaining) {
+			const SearchNode* CHILD = ROOT->children[edge].load(memory_order_acquire);
+			if (CHILD != nullptr && CHILD->proven.load(memory_order_relaxed) != NODE_UNPROVEN) {
+				continue;
+			}
+			open = true;
+			
+			unsigned int visits = ROOT->visits[edge].load(memory_order_relaxed) - gumbelRoot.startVisits[edge];
+			if (visits < gumbelRoot.phaseVisits && (selection == -1 || visits < fewestVisits)) {
+				selection = edge;
+				fewestVisits = visits;
+			}
 		}
 		
-		vector<float> moveProbs;
-		for (int move = 0; move < 81; move++) {
-			moveProbs.push_back(POTENTIAL_LEAF.isValid(move) ? (results.first.at(move) / total) : 0.0f);
+		if (selection != -1 || !open) {
+			return selection;
+		}
+		mHalveGumbelRoot(ROOT);
+	}
+}
+
+template<typename T, typename U>
+SearchNode* MCTS<T, U>::mDescend(SearchNode* node, U& gameState, vector<SearchStep>& path, SearchShared& shared) {
+	//The starting node is searched even when it is proven since a root proven by the solver still needs a move which keeps its result
+	while (node != nullptr && node->state.load(memory_order_acquire) == NODE_EXPANDED &&
+		(path.empty() || node->proven.load(memory_order_relaxed) == NODE_UNPROVEN)) {
+		//Only the root of the search follows the Gumbel schedule, which pondering skips since it has no budget to split
+		int gumbelEdge = mGumbel && !mPonder.searching && path.empty() ? mSelectGumbel(node, shared) : -1;
+		unsigned int edge = gumbelEdge != -1 ? gumbelEdge : mSelect(node, gameState.getNextPlayer());
+		SearchNode* child = node->children[edge].load(memory_order_acquire);
+		if (child == nullptr) {
+			lock_guard<mutex> lock(shared.arenaMutex);
+			child = node->children[edge].load(memory_order_relaxed);
+			if (child == nullptr && !mMemoryFull()) {
+				child = mArena.allocate<SearchNode>(1);
+				mNodeCount->fetch_add(1, memory_order_relaxed);
+				node->children[edge].store(child, memory_order_release);
+			}
 		}
 		
-		StateInfo stateInfo;
-		stateInfo.moveProbs = moveProbs;
-		mStateInfos.emplace(POTENTIAL_LEAF.getKey(), stateInfo);
+		//Counts the edge as a loss for the player choosing it until the simulation is backed up so other descents avoid it
+		float lostValue = gameState.getNextPlayer() == 0 ? 1.0f : 0.0f;
+		node->visits[edge].fetch_add(1, memory_order_relaxed);
+		atomicAdd(node->totalValues[edge], lostValue);
+		node->simulations.fetch_add(1, memory_order_relaxed);
+		path.push_back({node, edge, lostValue, gameState.getNextPlayer()});
 		
-		return results.second;
+		gameState.applyMove(node->moves[edge]);
+		node = child;
 	}
 	
-	//Selects child to explore
-	float bestSelectionScore = -1.0f;
-	int bestSelection = -1;
-	for (int move:POTENTIAL_LEAF.getValidMoves()) {
-		float selectionScore;
-		
-		map<string, StateInfo>::iterator childStateInfoIter = mStateInfos.find(POTENTIAL_LEAF.getChild(move).getKey());
+	return node;
+}
+
+template<typename T, typename U>
+void MCTS<T, U>::mBackup(const vector<SearchStep>& PATH, const float VALUE) {
+	for (const SearchStep& STEP:PATH) {
+		atomicAdd(STEP.node->totalValues[STEP.edge], VALUE - STEP.lostValue);
+	}
+}
+
+template<typename T, typename U>
+void MCTS<T, U>::mProve(const vector<SearchStep>& PATH) {
+	for (unsigned int i=PATH.size();i>0;i--) {
+		SearchNode* node = PATH[i - 1].node;
+		const unsigned int PLAYER = PATH[i - 1].player;
 		
-		if (childStateInfoIter != mStateInfos.end()) {
-			float childValue = childStateInfoIter->second.totalValue / childStateInfoIter->second.visits;
-			if (POTENTIAL_LEAF.getNextPlayer() == 0) {
-				childValue = 1 - childValue;
+		bool allProven = true, tie = false, won = false;
+		for (unsigned int edge=0;edge<node->edgeCount && !won;edge++) {
+			const SearchNode* CHILD = node->children[edge].load();
+			unsigned char proven = CHILD == nullptr ? NODE_UNPROVEN : CHILD->proven.load();
+			if (proven == PLAYER) {
+				won = true;
+			} else if (proven == NODE_UNPROVEN) {
+				allProven = false;
+			} else if (proven == 3) {
+				tie = true;
 			}
-			
-			selectionScore = childValue + EXPLORATION_PARAMETER * leafStateInfoIter->second.moveProbs.at(move) * sqrt((float)leafStateInfoIter->second.simulations) / (childStateInfoIter->second.visits + 1);
+		}
+		
+		if (won) {
+			node->proven.store(PLAYER);
+		} else if (allProven) {
+			node->proven.store(tie ? 3 : 1 - PLAYER);
 		} else {
-			selectionScore = 0.5f + EXPLORATION_PARAMETER * leafStateInfoIter->second.moveProbs.at(move) * sqrt((float)leafStateInfoIter->second.simulations + 0.00000001f);
+			return;
+		}
+	}
+}
+
+template<typename T, typename U>
+float MCTS<T, U>::mProvenValue(const unsigned char PROVEN) {
+	return PROVEN == 3 ? 0.5f : (float)PROVEN;
+}
+
+template<typename T, typename U>
+bool MCTS<T, U>::mEdgeLost(const SearchNode* NODE, const unsigned int EDGE, const unsigned int PLAYER) {
+	const SearchNode* CHILD = NODE->children[EDGE].load(memory_order_acquire);
+	return CHILD != nullptr && CHILD->proven.load(memory_order_relaxed) == 1 - PLAYER;
+}
+
+template<typename T, typename U>
+int MCTS<T, U>::mProvenEdge(const SearchNode* NODE) {
+	const unsigned char PROVEN = NODE->proven.load(memory_order_relaxed);
+	if (PROVEN == NODE_UNPROVEN || NODE->state.load(memory_order_acquire) != NODE_EXPANDED) {
+		return -1;
+	}
+	
+	for (unsigned int edge=0;edge<NODE->edgeCount;edge++) {
+		const SearchNode* CHILD = NODE->children[edge].load(memory_order_acquire);
+		if (CHILD != nullptr && CHILD->proven.load(memory_order_relaxed) == PROVEN) {
+			return edge;
+		}
+	}
+	
+	return -1;
+}
+
+template<typename T, typename U>
+void MCTS<T, U>::mRevert(const vector<SearchStep>& PATH) {
+	for (const SearchStep& STEP:PATH) {
+		STEP.node->visits[STEP.edge].fetch_sub(1, memory_order_relaxed);
+		atomicAdd(STEP.node->totalValues[STEP.edge], -STEP.lostValue);
+		STEP.node->simulations.fetch_sub(1, memory_order_relaxed);
+	}
+}
+
+template<typename T, typename U>
+bool MCTS<T, U>::mBestMoveDecided(const SearchNode* ROOT, const unsigned int CLAIMED) const {
+	//Moves proven to lose get no more visits and are never picked so they are left out
+	const unsigned int PLAYER = mRootGameState.getNextPlayer();
+	unsigned int openEdges = 0;
+	for (unsigned int edge=0;edge<ROOT->edgeCount;edge++) {
+		if (!mEdgeLost(ROOT, edge, PLAYER)) {
+			openEdges++;
+		}
+	}
+	if (openEdges <= 1) {
+		return true;
+	}
+	
+	//Without a simulation budget there is no way to know how many visits the other moves could still get
+	if (mTimeLimit > 0) {
+		return false;
+	}
+	if (CLAIMED >= mSimulations) {
+		return true;
+	}
+	
+	unsigned int mostVisits = 0, secondMostVisits = 0;
+	for (unsigned int edge=0;edge<ROOT->edgeCount;edge++) {
+		if (mEdgeLost(ROOT, edge, PLAYER)) {
+			continue;
 		}
 		
-		if (selectionScore > bestSelectionScore) {
-			bestSelectionScore = selectionScore;
-			bestSelection = move;
+		unsigned int visits = ROOT->visits[edge].load(memory_order_relaxed);
+		if (visits > mostVisits) {
+			secondMostVisits = mostVisits;
+			mostVisits = visits;
+		} else if (visits > secondMostVisits) {
+			secondMostVisits = visits;
 		}
 	}
 	
-	const U CHILD = POTENTIAL_LEAF.getChild(bestSelection);
+	return mostVisits - secondMostVisits > mSimulations - CLAIMED;
+}
+
+template<typename T, typename U>
+int MCTS<T, U>::mForcedMove(const U& BASE_GAME_STATE) const {
+	if (BASE_GAME_STATE.getValidMoveCount() == 1) {
+		return BASE_GAME_STATE.getValidMove(0);
+	}
+	if (!mRootSearches.empty() || mRoot == nullptr || mRootGameState.getHash() != BASE_GAME_STATE.getHash() ||
+		mRoot->state.load() != NODE_EXPANDED) {
+		return -1;
+	}
+	
+	int forcedMove = -1;
+	for (unsigned int edge=0;edge<mRoot->edgeCount;edge++) {
+		if (!mEdgeLost(mRoot, edge, BASE_GAME_STATE.getNextPlayer())) {
+			if (forcedMove != -1) {
+				return -1;
+			}
+			forcedMove = mRoot->moves[edge];
+		}
+	}
 	
-	float value = mSimulate(CHILD);
+	return forcedMove;
+}
+
+template<typename T, typename U>
+bool MCTS<T, U>::mSearchFinished(const SearchNode* ROOT, const bool ROOT_ENDED, SearchShared& shared) {
+	if (mCancellation.isCancelled()) {
+		return true;
+	}
 	
-	map<string, StateInfo>::iterator childStateInfoIter = mStateInfos.find(CHILD.getKey());
+	//Pondering searches until the opponent moves, unless there is nothing left to learn or no room to learn it
+	if (mPonder.searching) {
+		shared.simulations.fetch_add(1);
+		return mStopRequested->load(memory_order_relaxed) || mMemoryFull() ||
+			(ROOT->state.load(memory_order_acquire) == NODE_EXPANDED && mProvenEdge(ROOT) != -1);
+	}
 	
-	//Updates values
-	if (childStateInfoIter != mStateInfos.end()) {
-		childStateInfoIter->second.totalValue += value;
-		childStateInfoIter->second.visits++;
-	} else {
-		StateInfo stateInfo;
-		stateInfo.totalValue = value;
-		stateInfo.visits++;
-		mStateInfos.emplace(CHILD.getKey(), stateInfo);
+	if (ROOT_ENDED || ROOT->state.load(memory_order_acquire) == NODE_EXPANDED) {
+		if (mStopRequested->load(memory_order_relaxed) || mProvenEdge(ROOT) != -1) {
+			return true;
+		}
+		if (mTimeLimit > 0 && chrono::steady_clock::now() >= shared.deadline) {
+			return true;
+		}
+		if (mEarlyStopping && !ROOT_ENDED && !mGumbel && mBestMoveDecided(ROOT, shared.simulations.load())) {
+			return true;
+		}
+		
+		//Sequential halving has decided once one move is left, but with a time limit that move is searched until the time is up
+		if (mEarlyStopping && !ROOT_ENDED && mGumbel && mTimeLimit == 0) {
+			lock_guard<mutex> lock(shared.gumbelMutex);
+			if (mGumbelRoot.started && mGumbelRoot.remaining.size() <= 1) {
+				return true;
+			}
+		}
 	}
-	leafStateInfoIter->second.simulations++;
 	
-	return value;
+	//The simulation is claimed even with a time limit so the count stays right for giving simulations back
+	return shared.simulations.fetch_add(1) >= mSimulations && mTimeLimit == 0;
 }
 
 template<typename T, typename U>
-void MCTS<T, U>::mMCTS(const U BASE_GAME_STATE) {
-    for (unsigned int i=0;i<mSimulations;i++) {
-        mSimulate(BASE_GAME_STATE);
-    }
+void MCTS<T, U>::mRunWorker(SearchNode* root, const U& BASE_GAME_STATE, SearchShared& shared) {
+	const bool ROOT_ENDED = BASE_GAME_STATE.getEnd() != 2;
+	//Virtual losses send the leaves of a batch down different paths, which with a small budget spreads most of it across the root before
+	//any result comes back, so the batch shrinks with the budget
+	const unsigned int BATCH_SIZE = mTimeLimit == 0 ? min(mBatchSize, max(1u, mSimulations / SIMULATIONS_PER_BATCH_LEAF)) : mBatchSize;
+	vector<vector<SearchStep>> paths(BATCH_SIZE);
+	vector<PendingLeaf> pendingLeaves;
+	vector<U> evaluatedStates;
+	
+	bool finished = false;
+	while (!finished) {
+		pendingLeaves.clear();
+		evaluatedStates.clear();
+		
+		//Collects leaves until the batch is full or a descent reaches a leaf which is already waiting for evaluation
+		SearchNode* collided = nullptr;
+		while (pendingLeaves.size() < BATCH_SIZE && !collided) {
+			if (mSearchFinished(root, ROOT_ENDED, shared)) {
+				finished = true;
+				break;
+			}
+			
+			vector<SearchStep>& path = paths[pendingLeaves.size()];
+			path.clear();
+			U gameState = BASE_GAME_STATE;
+			SearchNode* leaf = mDescend(root, gameState, path, shared);
+			
+			//Game states with a known result are backed up with it straight away and prove what they can above them
+			if (leaf != nullptr && leaf != root && leaf->proven.load(memory_order_relaxed) != NODE_UNPROVEN) {
+				mBackup(path, mProvenValue(leaf->proven.load(memory_order_relaxed)));
+				shared.completed.fetch_add(1, memory_order_relaxed);
+				continue;
+			}
+			if (gameState.getEnd() != 2) {
+				mBackup(path, mProvenValue(gameState.getEnd()));
+				shared.completed.fetch_add(1, memory_order_relaxed);
+				if (leaf != nullptr) {
+					leaf->proven.store(gameState.getEnd());
+					mProve(path);
+				}
+				continue;
+			}
+			
+			//The root is always expanded so there are moves to choose from even when it could be solved
+			if (leaf != root && gameState.getEmptyCount() < mSolverThreshold) {
+				lock_guard<mutex> lock(shared.solverMutex);
+				float solvedValue;
+				if (mSolver.solve(gameState, solvedValue)) {
+					mBackup(path, solvedValue);
+					shared.completed.fetch_add(1, memory_order_relaxed);
+					if (leaf != nullptr) {
+						leaf->proven.store(solvedValue == 0.5f ? 3 : (unsigned char)solvedValue);
+						mProve(path);
+					}
+					continue;
+				}
+			}
+			
+			//Only the descent which claims the leaf evaluates it, any other gives its simulation back to be run again later, while a
+			//leaf without a node is evaluated by every descent which reaches it since it is never expanded
+			unsigned char unexpanded = NODE_UNEXPANDED;
+			if (leaf != nullptr && !leaf->state.compare_exchange_strong(unexpanded, NODE_EXPANDING)) {
+				mRevert(path);
+				shared.simulations.fetch_sub(1);
+				collided = leaf;
+				continue;
+			}
+			
+			unsigned int symmetry = mUseSymmetries ? gameState.getCanonicalSymmetry() : 0;
+			pendingLeaves.push_back({leaf, gameState, symmetry});
+			evaluatedStates.push_back(mUseSymmetries ? gameState.getSymmetry(symmetry) : gameState);
+		}
+		
+		//A thread with nothing to evaluate sleeps until the leaf it reached is evaluated instead of spinning on the cores the evaluator
+		//needs, such as while every thread waits on the root, waking at least every millisecond to check the time and cancellation
+		if (pendingLeaves.empty()) {
+			if (collided != nullptr) {
+				unique_lock<mutex> lock(shared.expandedMutex);
+				shared.expanded.wait_for(lock, chrono::milliseconds(1), [this, collided]() {
+					return collided->state.load(memory_order_acquire) != NODE_EXPANDING || mCancellation.isCancelled();
+				});
+			}
+			continue;
+		}
+		
+		//A cancelled search drops the batch instead of waiting on the evaluator, which also gives up on it if the search is cancelled while
+		//the batch waits for the neural net or the server, giving its leaves and simulations back
+		bool cancelled = mCancellation.isCancelled();
+		vector<pair<vector<float>, float>> results;
+		if (!cancelled) {
+			try {
+				results = mEvaluator.predictBatch(evaluatedStates, mCancellation);
+			} catch (const SearchCancelled&) {
+				cancelled = true;
+			}
+		}
+		if (cancelled) {
+			for (unsigned int i=0;i<pendingLeaves.size();i++) {
+				mRevert(paths[i]);
+				if (pendingLeaves[i].node != nullptr) {
+					pendingLeaves[i].node->state.store(NODE_UNEXPANDED, memory_order_release);
+				}
+			}
+			shared.simulations.fetch_sub(pendingLeaves.size());
+			mNotifyExpanded(shared);
+			break;
+		}
+		
+		for (unsigned int i=0;i<pendingLeaves.size();i++) {
+			if (pendingLeaves[i].node != nullptr) {
+				mExpand(pendingLeaves[i].node, pendingLeaves[i].gameState, pendingLeaves[i].symmetry, results.at(i), shared);
+			}
+			mBackup(paths[i], results.at(i).second);
+		}
+		shared.completed.fetch_add(pendingLeaves.size(), memory_order_relaxed);
+		mNotifyExpanded(shared);
+	}
+}
+
+template<typename T, typename U>
+void MCTS<T, U>::mNotifyExpanded(SearchShared& shared) {
+	//Taking the lock keeps a thread from missing the wake up between checking the leaf and starting to wait
+	{
+		lock_guard<mutex> lock(shared.expandedMutex);
+	}
+	shared.expanded.notify_all();
+}
+
+template<typename T, typename U>
+unsigned int MCTS<T, U>::mMCTS(const U BASE_GAME_STATE) {
+	//Independent searches share nothing while running, not even a neural net, so each gets its own thread without any synchronization
+	if (!mRootSearches.empty()) {
+		mConfigureRootSearches();
+		vector<unsigned int> simulations(mRootSearches.size());
+		vector<thread> searches;
+		for (unsigned int i=0;i<mRootSearches.size();i++) {
+			searches.emplace_back([this, &simulations, i, &BASE_GAME_STATE]() {
+				simulations[i] = mRootSearches[i]->mMCTS(BASE_GAME_STATE);
+			});
+		}
+		
+		unsigned int totalSimulations = 0;
+		for (unsigned int i=0;i<searches.size();i++) {
+			searches[i].join();
+			totalSimulations += simulations[i];
+		}
+		return totalSimulations;
+	}
+	
+	//Compacting the tree moves the root so it is read afterwards
+	mGetRoot(BASE_GAME_STATE);
+	mEvict();
+	SearchNode* root = mRoot;
+	mGumbelRoot.started = false;
+	SearchShared shared;
+	shared.deadline = chrono::steady_clock::now() + chrono::milliseconds(mTimeLimit);
+	
+	vector<thread> workers;
+	for (unsigned int i=1;i<mThreads;i++) {
+		workers.emplace_back(&MCTS<T, U>::mRunWorker, this, root, cref(BASE_GAME_STATE), ref(shared));
+	}
+	mRunWorker(root, BASE_GAME_STATE, shared);
+	for (thread& worker:workers) {
+		worker.join();
+	}
+	
+	return shared.completed.load();
 }
 
 #endif
\ No newline at end of file
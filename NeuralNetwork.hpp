@@ -1,16 +1,25 @@
 /* Author: Hanuman Chu
  * 
- * Creates templated Neural Network class which has loading and saving functionality
+ * Creates templated Neural Network class which has loading and saving functionality and caches the evaluations of game states
  */
 #ifndef NEURAL_NETWORK_HPP
 #define NEURAL_NETWORK_HPP
 
 #include <torch/torch.h>
 
+#include "EvaluationCache.h"
+#include "CancellationToken.h"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <atomic>
 #include <string>
 #include <random>
+#include <sstream>
 #include <stdexcept>
 #include <vector>
+#include <functional>
 using namespace std;
 
 template<typename T>
@@ -19,8 +28,10 @@ public:
 	/**
 	 * @brief Constructor which sets the board size to the given size with a minimum of one
 	 * @param BOARD_SIZE size of the game boards the neural network will accept
+	 * @param INPUT_PLANES number of board sized planes in each input with a minimum of one, passed on to the neural net's constructor
+	 * @param ENCODE_FLAGS flags passed to the game state's encode function when predicting from a game state
 	 */
-	NeuralNetwork(unsigned const int BOARD_SIZE);
+	NeuralNetwork(unsigned const int BOARD_SIZE, unsigned const int INPUT_PLANES = 1, unsigned const int ENCODE_FLAGS = 0);
 	
 	/**
 	 * @brief Runs given board through neural net and returns the results
@@ -30,6 +41,30 @@ public:
 	 */
 	pair<vector<float>, float> predict(const vector<float> BOARD);
 	
+	/**
+	 * @brief Encodes given game state directly into the reused input tensor, runs it through neural net and returns the results, unless
+	 *        the current model already evaluated the game state and it is still in the cache
+	 * @param GAME_STATE game state to run through neural net
+	 * @return pair with the first element being the move probabilities of the given game state and the second element being the value of the given game state
+	 * @throws invalid_argument if the game state's encoding is not of the correct size
+	 */
+	template<typename U>
+	pair<vector<float>, float> predict(const U& GAME_STATE);
+	
+	/**
+	 * @brief Encodes given game states into the reused input tensor and runs them through neural net together in a single batch, where
+	 *        game states found in the cache are left out of the batch
+	 * @param GAME_STATES game states to run through neural net
+	 * @param CANCELLATION token checked again once it is this batch's turn to run through neural net, so a cancelled search does not
+	 *        wait behind the batches of other threads and then run its own
+	 * @return list of pairs in the same order as the game states with the first element being the move probabilities and the second
+	 *         element being the value of each game state
+	 * @throws invalid_argument if the game state's encoding is not of the correct size
+	 * @throws SearchCancelled if the token was cancelled before the batch ran through neural net
+	 */
+	template<typename U>
+	vector<pair<vector<float>, float>> predictBatch(const vector<U>& GAME_STATES, const CancellationToken& CANCELLATION = CancellationToken());
+	
 	/**
 	 * @brief Trains neural net on given examples using the given batch size
 	 * @param EXAMPLES vector of tuples each holding a game board, the move probabilities for that game board, and the value of that game board
@@ -51,6 +86,26 @@ public:
 	 * @return whether the neural net saved successfully 
 	 */
 	bool save(const string FILE_PATH) const;
+	
+	/**
+	 * @brief Returns a copy with its own neural net holding the same weights, which runs boards through its neural net without waiting for
+	 *        this one and shares the cache, but does not see this neural network being loaded or trained afterwards
+	 * @return neural network with a separate neural net
+	 */
+	NeuralNetwork<T> clone() const;
+	
+	/**
+	 * @brief Returns the cache of evaluations shared by copies of this neural network, which can be used to read its hit rate or resize it
+	 * @return evaluation cache
+	 */
+	shared_ptr<EvaluationCache> getCache() const;
+	
+	/**
+	 * @brief Returns the version of the model, which changes whenever it is loaded or trained and is never the same for two different
+	 *        models, so a clone has the weights of its original as long as their versions match
+	 * @return version of the model
+	 */
+	unsigned int getVersion() const;
 private:
 	/**
 	 * @brief neural net to run boards through
@@ -60,42 +115,138 @@ private:
 	 * @brief size of the boards to accept
 	 */
 	unsigned int mBoardSize;
+	/**
+	 * @brief number of board sized planes in each input
+	 */
+	unsigned int mInputPlanes;
+	/**
+	 * @brief flags passed to the game state's encode function
+	 */
+	unsigned int mEncodeFlags;
+	/**
+	 * @brief lets one thread at a time run boards through neural net, shared by copies since they share the neural net
+	 */
+	shared_ptr<mutex> mForwardMutex;
+	/**
+	 * @brief input tensor boards are encoded into, which only grows when a batch needs more rows than it has, guarded by mForwardMutex
+	 *        and shared by copies along with it
+	 */
+	shared_ptr<torch::Tensor> mInput;
+	/**
+	 * @brief evaluations of game states by hash, shared by copies since they share the neural net and by clones, which keep their
+	 *        evaluations apart by version
+	 */
+	shared_ptr<EvaluationCache> mCache;
+	/**
+	 * @brief version of the model which is replaced whenever it is loaded or trained so older evaluations in the cache are not used,
+	 *        shared by copies since they share the neural net
+	 */
+	shared_ptr<atomic<unsigned int>> mVersion;
+	
+	/**
+	 * @brief Returns a version no model has had before, so clones sharing a cache never mistake each other's evaluations for their own
+	 * @return new version
+	 */
+	static unsigned int mNewVersion();
+	
+	/**
+	 * @brief Has a batch of inputs written into the reused input tensor, runs them through neural net and returns the results
+	 * @param BATCH_SIZE number of inputs in the batch
+	 * @param ENCODE writes the batch into the memory of the input tensor given to it, one input after another
+	 * @param CANCELLATION token checked after waiting for neural net
+	 * @return list of pairs with the first element being the move probabilities and the second element being the value of each input
+	 * @throws SearchCancelled if the token was cancelled while waiting for neural net
+	 */
+	vector<pair<vector<float>, float>> mForward(const unsigned int BATCH_SIZE, const function<void(float*)>& ENCODE,
+		const CancellationToken& CANCELLATION = CancellationToken());
 };
 
 template<typename T>
-NeuralNetwork<T>::NeuralNetwork(unsigned const int BOARD_SIZE) {
+NeuralNetwork<T>::NeuralNetwork(unsigned const int BOARD_SIZE, unsigned const int INPUT_PLANES, unsigned const int ENCODE_FLAGS) : mNet(INPUT_PLANES < 1 ? 1 : INPUT_PLANES) {
 	if (BOARD_SIZE < 1) {
 		mBoardSize = 1;
 	} else {
 		mBoardSize = BOARD_SIZE;
 	}
+	mInputPlanes = INPUT_PLANES < 1 ? 1 : INPUT_PLANES;
+	mEncodeFlags = ENCODE_FLAGS;
+	mForwardMutex = make_shared<mutex>();
+	mInput = make_shared<torch::Tensor>(torch::empty({0, (int64_t)(mBoardSize * mInputPlanes)}, torch::TensorOptions(torch::kCPU)));
+	mCache = make_shared<EvaluationCache>();
+	mVersion = make_shared<atomic<unsigned int>>(mNewVersion());
 }
 
 template<typename T>
 pair<vector<float>, float> NeuralNetwork<T>::predict(const vector<float> BOARD) {
-	if (BOARD.size() != mBoardSize) {
+	if (BOARD.size() != mBoardSize * mInputPlanes) {
 		throw invalid_argument("Board is not the correct size.");
 	}
 	
-	vector<float> board = BOARD;
-	torch::Tensor tBoard = torch::from_blob(board.data(), {1, mBoardSize}, torch::TensorOptions(torch::kCPU)).clone();
+	return mForward(1, [&BOARD](float* input) {
+		copy(BOARD.begin(), BOARD.end(), input);
+	}).at(0);
+}
+
+template<typename T>
+template<typename U>
+pair<vector<float>, float> NeuralNetwork<T>::predict(const U& GAME_STATE) {
+	if (U::getEncodedPlanes(mEncodeFlags) != mInputPlanes) {
+		throw invalid_argument("Game state encoding is not the correct size.");
+	}
 	
-	torch::NoGradGuard no_grad;
-	mNet->eval();
-	mNet->to(torch::Device(torch::kCPU));
+	const unsigned int VERSION = mVersion->load();
+	pair<vector<float>, float> result;
+	if (mCache->find(GAME_STATE.getHash(), VERSION, result)) {
+		return result;
+	}
 	
-	vector<torch::Tensor> results = mNet(tBoard);
-	results.at(0) = results.at(0).exp();
-	vector<float> probs = vector<float>(results.at(0).data_ptr<float>(), results.at(0).data_ptr<float>() + results.at(0).numel());
-	float value = results.at(1).item<float>();
+	result = mForward(1, [this, &GAME_STATE](float* input) {
+		GAME_STATE.encode(input, mEncodeFlags);
+	}).at(0);
+	mCache->insert(GAME_STATE.getHash(), VERSION, result);
+	return result;
+}
+
+template<typename T>
+template<typename U>
+vector<pair<vector<float>, float>> NeuralNetwork<T>::predictBatch(const vector<U>& GAME_STATES, const CancellationToken& CANCELLATION) {
+	if (U::getEncodedPlanes(mEncodeFlags) != mInputPlanes) {
+		throw invalid_argument("Game state encoding is not the correct size.");
+	}
 	
-	return {probs, value};
+	const unsigned int VERSION = mVersion->load();
+	vector<pair<vector<float>, float>> results(GAME_STATES.size());
+	vector<unsigned int> misses;
+	for (unsigned int i=0;i<GAME_STATES.size();i++) {
+		if (!mCache->find(GAME_STATES[i].getHash(), VERSION, results[i])) {
+			misses.push_back(i);
+		}
+	}
+	if (misses.empty()) {
+		return results;
+	}
+	if (CANCELLATION.isCancelled()) {
+		throw SearchCancelled();
+	}
+	
+	const unsigned int INPUT_SIZE = mBoardSize * mInputPlanes;
+	vector<pair<vector<float>, float>> predictions = mForward(misses.size(), [this, &GAME_STATES, &misses, INPUT_SIZE](float* input) {
+		for (unsigned int i=0;i<misses.size();i++) {
+			GAME_STATES[misses[i]].encode(input + i * INPUT_SIZE, mEncodeFlags);
+		}
+	}, CANCELLATION);
+	for (unsigned int i=0;i<misses.size();i++) {
+		mCache->insert(GAME_STATES[misses[i]].getHash(), VERSION, predictions[i]);
+		results[misses[i]] = move(predictions[i]);
+	}
+	
+	return results;
 }
 
 template<typename T>
 void NeuralNetwork<T>::train(const vector<tuple<vector<float>, vector<float>, float>> EXAMPLES, const int BATCH_SIZE) {
 	for (const tuple<vector<float>, vector<float>, float> EXAMPLE:EXAMPLES) {
-		if (get<0>(EXAMPLE).size() != mBoardSize || get<1>(EXAMPLE).size() != mBoardSize) {
+		if (get<0>(EXAMPLE).size() != mBoardSize * mInputPlanes || get<1>(EXAMPLE).size() != mBoardSize) {
 			throw invalid_argument("At least one example was not correctly formatted.");
 		}
 	}
@@ -118,7 +269,7 @@ void NeuralNetwork<T>::train(const vector<tuple<vector<float>, vector<float>, fl
 			values.push_back(get<2>(EXAMPLES.at(index)));
 		}
 		
-		torch::Tensor tBoards = torch::from_blob(boards.data(), {BATCH_SIZE, mBoardSize}).clone().to(torch::Device(torch::kCPU));
+		torch::Tensor tBoards = torch::from_blob(boards.data(), {BATCH_SIZE, mBoardSize * mInputPlanes}).clone().to(torch::Device(torch::kCPU));
 		torch::Tensor tProbs = torch::from_blob(probs.data(), {BATCH_SIZE, mBoardSize}).clone().to(torch::Device(torch::kCPU));
 		torch::Tensor tValues = torch::from_blob(values.data(), {BATCH_SIZE, 1}).clone().to(torch::Device(torch::kCPU));
 		
@@ -131,6 +282,8 @@ void NeuralNetwork<T>::train(const vector<tuple<vector<float>, vector<float>, fl
 		totalLoss.backward();
 		optimizer.step();
 	}
+	
+	mVersion->store(mNewVersion());
 }
 
 template<typename T>
@@ -141,6 +294,7 @@ bool NeuralNetwork<T>::load(const string FILE_PATH) {
 		return false;
 	}
 	
+	mVersion->store(mNewVersion());
 	return true;
 }
 
@@ -155,4 +309,72 @@ bool NeuralNetwork<T>::save(const string FILE_PATH) const {
 	return true;
 }
 
+template<typename T>
+NeuralNetwork<T> NeuralNetwork<T>::clone() const {
+	//Going through the serialized weights copies every parameter and buffer without the module having to be cloneable
+	NeuralNetwork<T> copy(mBoardSize, mInputPlanes, mEncodeFlags);
+	stringstream weights;
+	unsigned int version;
+	{
+		lock_guard<mutex> lock(*mForwardMutex);
+		torch::save(mNet, weights);
+		version = mVersion->load();
+	}
+	torch::load(copy.mNet, weights);
+	copy.mCache = mCache;
+	copy.mVersion->store(version);
+	
+	return copy;
+}
+
+template<typename T>
+shared_ptr<EvaluationCache> NeuralNetwork<T>::getCache() const {
+	return mCache;
+}
+
+template<typename T>
+unsigned int NeuralNetwork<T>::getVersion() const {
+	return mVersion->load();
+}
+
+template<typename T>
+unsigned int NeuralNetwork<T>::mNewVersion() {
+	static atomic<unsigned int> nextVersion(0);
+	return nextVersion++;
+}
+
+template<typename T>
+vector<pair<vector<float>, float>> NeuralNetwork<T>::mForward(const unsigned int BATCH_SIZE, const function<void(float*)>& ENCODE,
+	const CancellationToken& CANCELLATION) {
+	//Every thread sharing neural net can be queued here, so a cancelled search skips its forward pass instead of waiting its turn for it
+	lock_guard<mutex> lock(*mForwardMutex);
+	if (CANCELLATION.isCancelled()) {
+		throw SearchCancelled();
+	}
+	
+	//The input tensor is only allocated again when a batch is bigger than every batch before it, and is encoded into while the lock is
+	//held since every thread sharing neural net writes into the same memory
+	if (mInput->size(0) < (int64_t)BATCH_SIZE) {
+		*mInput = torch::empty({(int64_t)BATCH_SIZE, (int64_t)(mBoardSize * mInputPlanes)}, torch::TensorOptions(torch::kCPU));
+	}
+	ENCODE(mInput->data_ptr<float>());
+	
+	torch::NoGradGuard no_grad;
+	mNet->eval();
+	mNet->to(torch::Device(torch::kCPU));
+	
+	vector<torch::Tensor> results = mNet(mInput->narrow(0, 0, BATCH_SIZE));
+	results.at(0) = results.at(0).exp().contiguous();
+	results.at(1) = results.at(1).contiguous();
+	const float* PROBS = results.at(0).data_ptr<float>();
+	const float* VALUES = results.at(1).data_ptr<float>();
+	
+	vector<pair<vector<float>, float>> predictions;
+	for (unsigned int i=0;i<BATCH_SIZE;i++) {
+		predictions.push_back({vector<float>(PROBS + i * mBoardSize, PROBS + (i + 1) * mBoardSize), VALUES[i]});
+	}
+	
+	return predictions;
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,182 @@
+/* Author: Hanuman Chu
+ *
+ * Creates SearchArena class which hands out memory for the MCTS tree from large blocks and SearchNode struct which is one game state in
+ * the MCTS tree, with the statistics of nodes and edges held in atomics so several threads can search one tree
+ */
+#ifndef SEARCH_TREE_H
+#define SEARCH_TREE_H
+
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <cstddef>
+#include <utility>
+using namespace std;
+
+const size_t ARENA_BLOCK_SIZE = 1 << 20;
+
+//Expansion states of a node, where only the thread which moves a node out of NODE_UNEXPANDED evaluates and expands it
+const unsigned char NODE_UNEXPANDED = 0;
+const unsigned char NODE_EXPANDING = 1;
+const unsigned char NODE_EXPANDED = 2;
+
+//Proven results use the format of getEnd with 0 if X wins, 1 if O wins and 3 for a tie, leaving 2 for a node whose result is not certain
+const unsigned char NODE_UNPROVEN = 2;
+
+/**
+ * @brief Adds to an atomic float with a compare and swap loop since atomic floats have no fetch_add before C++20
+ * @param target float to add to
+ * @param VALUE amount to add
+ */
+inline void atomicAdd(atomic<float>& target, const float VALUE) {
+	float expected = target.load(memory_order_relaxed);
+	while (!target.compare_exchange_weak(expected, expected + VALUE, memory_order_relaxed)) {}
+}
+
+class SearchArena {
+public:
+	/**
+	 * @brief Constructs an empty arena which allocates blocks of the given size when it needs more memory
+	 * @param BLOCK_SIZE number of bytes in each block
+	 */
+	SearchArena(const size_t BLOCK_SIZE = ARENA_BLOCK_SIZE) : mBlockSize(BLOCK_SIZE), mBlock(0), mOffset(0), mBytesUsed(0) {}
+
+	/**
+	 * @brief Move constructor which takes the blocks of the other arena
+	 * @param other arena to move from
+	 */
+	SearchArena(SearchArena&& other) : mBlocks(move(other.mBlocks)), mBlockSize(other.mBlockSize), mBlock(other.mBlock),
+		mOffset(other.mOffset), mBytesUsed(other.mBytesUsed.load()) {}
+
+	/**
+	 * @brief Move assignment which takes the blocks of the other arena
+	 * @param other arena to move from
+	 * @return this arena
+	 */
+	SearchArena& operator=(SearchArena&& other) {
+		mBlocks = move(other.mBlocks);
+		mBlockSize = other.mBlockSize;
+		mBlock = other.mBlock;
+		mOffset = other.mOffset;
+		mBytesUsed.store(other.mBytesUsed.load());
+		return *this;
+	}
+
+	/**
+	 * @brief Returns memory for the given number of value initialized objects which stays valid until the arena is reset
+	 * @param COUNT number of objects
+	 * @return pointer to the first object
+	 * @throws invalid_argument if the objects do not fit in one block
+	 */
+	template<typename V>
+	V* allocate(const size_t COUNT) {
+		const size_t BYTES = COUNT * sizeof(V);
+		if (BYTES > mBlockSize) {
+			throw invalid_argument("Allocation is larger than an arena block.");
+		}
+
+		size_t offset = (mOffset + alignof(V) - 1) & ~(alignof(V) - 1);
+		if (mBlock == mBlocks.size() || offset + BYTES > mBlockSize) {
+			if (mBlock < mBlocks.size()) {
+				mBlock++;
+			}
+			if (mBlock == mBlocks.size()) {
+				mBlocks.emplace_back(new char[mBlockSize]);
+			}
+			offset = 0;
+			mOffset = 0;
+		}
+
+		V* objects = reinterpret_cast<V*>(mBlocks[mBlock].get() + offset);
+		for (size_t i=0;i<COUNT;i++) {
+			new (objects + i) V();
+		}
+		mBytesUsed.fetch_add(offset + BYTES - mOffset, memory_order_relaxed);
+		mOffset = offset + BYTES;
+
+		return objects;
+	}
+
+	/**
+	 * @brief Frees everything allocated at once while keeping the blocks for reuse
+	 */
+	void reset() {
+		mBlock = 0;
+		mOffset = 0;
+		mBytesUsed = 0;
+	}
+
+	/**
+	 * @brief Returns the number of bytes handed out since the last reset, including alignment padding, which can be read while another
+	 *        thread allocates
+	 * @return bytes used
+	 */
+	size_t getBytesUsed() const {
+		return mBytesUsed.load(memory_order_relaxed);
+	}
+private:
+	/**
+	 * @brief blocks of memory objects are allocated from, which are only freed when the arena is destroyed
+	 */
+	vector<unique_ptr<char[]>> mBlocks;
+	/**
+	 * @brief number of bytes in each block
+	 */
+	size_t mBlockSize;
+	/**
+	 * @brief index of the block currently allocated from
+	 */
+	size_t mBlock;
+	/**
+	 * @brief number of bytes already used in the current block
+	 */
+	size_t mOffset;
+	/**
+	 * @brief number of bytes handed out since the last reset
+	 */
+	atomic<size_t> mBytesUsed;
+};
+
+struct SearchNode {
+	/**
+	 * @brief the number of simulations that went past this game state
+	 */
+	atomic<unsigned int> simulations{0};
+	/**
+	 * @brief the number of moves out of this game state, which is 0 until the game state is expanded
+	 */
+	unsigned int edgeCount = 0;
+	/**
+	 * @brief NODE_UNEXPANDED, NODE_EXPANDING while its evaluation is pending, or NODE_EXPANDED once the edges can be read
+	 */
+	atomic<unsigned char> state{NODE_UNEXPANDED};
+	/**
+	 * @brief result of the game state once it is proven by the game ending, the solver, or the results of its children, NODE_UNPROVEN
+	 *        until then
+	 */
+	atomic<unsigned char> proven{NODE_UNPROVEN};
+	/**
+	 * @brief move made by each edge
+	 */
+	unsigned char* moves = nullptr;
+	/**
+	 * @brief probability of each edge given by the leaf evaluator, normalized over valid moves
+	 */
+	float* priors = nullptr;
+	/**
+	 * @brief the number of times each edge was visited
+	 */
+	atomic<unsigned int>* visits = nullptr;
+	/**
+	 * @brief the total value from all of the simulations that went through each edge
+	 */
+	atomic<float>* totalValues = nullptr;
+	/**
+	 * @brief game state each edge leads to, null until the edge is first visited
+	 */
+	atomic<SearchNode*>* children = nullptr;
+};
+
+#endif
@@ -0,0 +1,204 @@
+/* Author: Hanuman Chu
+ *
+ * Creates templated Solver class which finds the exact result of a game state with alpha beta search and a transposition table
+ */
+#ifndef SOLVER_HPP
+#define SOLVER_HPP
+
+#include <algorithm>
+#include <vector>
+#include <cstdint>
+using namespace std;
+
+//Scores used inside the search, ordered from X's best result to O's best result
+const int SCORE_X_WINS = 0;
+const int SCORE_TIE = 1;
+const int SCORE_O_WINS = 2;
+
+template<typename U>
+class Solver {
+public:
+	/**
+	 * @brief Constructs a new Solver with a transposition table of 2 to the given power entries and a limit on positions searched per solve
+	 * @param TABLE_BITS log base 2 of the number of transposition table entries
+	 * @param NODE_LIMIT number of positions one call to solve may search before giving up
+	 */
+	Solver(const unsigned int TABLE_BITS = 18, const unsigned long long NODE_LIMIT = 200000);
+
+	/**
+	 * @brief Searches given game state to the end of the game and writes its exact value if the search finishes within the node limit
+	 * @param gameState game state to solve, moves are applied to it and undone so it is unchanged afterwards
+	 * @param value set to 0 if X wins, 1 if O wins, and 0.5 for a tie when solved
+	 * @return true if the game state was solved, false if the node limit was reached
+	 */
+	bool solve(U& gameState, float& value);
+
+	/**
+	 * @brief Clears the transposition table
+	 */
+	void clear();
+private:
+	/**
+	 * @brief Holds the bounds found for one game state
+	 */
+	struct Entry {
+		/**
+		 * @brief hash of the game state or 0 if the entry is empty
+		 */
+		uint64_t hash;
+		/**
+		 * @brief lowest score the game state can have
+		 */
+		unsigned char lower;
+		/**
+		 * @brief highest score the game state can have
+		 */
+		unsigned char upper;
+		/**
+		 * @brief move which gave the best score last time, tried first
+		 */
+		unsigned char bestMove;
+	};
+
+	/**
+	 * @brief transposition table indexed by the low bits of game state hashes, allocated on first use
+	 */
+	vector<Entry> mTable;
+	/**
+	 * @brief log base 2 of the number of transposition table entries
+	 */
+	unsigned int mTableBits;
+	/**
+	 * @brief number of positions one call to solve may search
+	 */
+	unsigned long long mNodeLimit;
+	/**
+	 * @brief number of positions searched in the current call to solve
+	 */
+	unsigned long long mNodes;
+
+	/**
+	 * @brief Returns the score of a game state within the window alpha to beta where X minimizes and O maximizes
+	 * @param gameState game state to search
+	 * @param alpha score O is already guaranteed
+	 * @param beta score X is already guaranteed
+	 * @return score of game state, only meaningful while mNodes is within mNodeLimit
+	 */
+	int mSearch(U& gameState, int alpha, int beta);
+};
+
+template<typename U>
+Solver<U>::Solver(const unsigned int TABLE_BITS, const unsigned long long NODE_LIMIT) : mTableBits(TABLE_BITS), mNodeLimit(NODE_LIMIT), mNodes(0) {}
+
+template<typename U>
+bool Solver<U>::solve(U& gameState, float& value) {
+	if (mTable.empty()) {
+		mTable = vector<Entry>((size_t)1 << mTableBits, Entry{0, SCORE_X_WINS, SCORE_O_WINS, 0});
+	}
+
+	mNodes = 0;
+	int score = mSearch(gameState, SCORE_X_WINS, SCORE_O_WINS);
+	if (mNodes > mNodeLimit) {
+		return false;
+	}
+
+	value = score / 2.0f;
+	return true;
+}
+
+template<typename U>
+void Solver<U>::clear() {
+	mTable.clear();
+}
+
+template<typename U>
+int Solver<U>::mSearch(U& gameState, int alpha, int beta) {
+	switch (gameState.getEnd()) {
+		case 0:
+			return SCORE_X_WINS;
+		case 1:
+			return SCORE_O_WINS;
+		case 3:
+			return SCORE_TIE;
+	}
+
+	if (++mNodes > mNodeLimit) {
+		return SCORE_TIE;
+	}
+
+	Entry& entry = mTable[gameState.getHash() & (((uint64_t)1 << mTableBits) - 1)];
+	int bestMove = -1;
+	if (entry.hash == gameState.getHash()) {
+		if (entry.lower >= beta || entry.lower == entry.upper) {
+			return entry.lower;
+		}
+		if (entry.upper <= alpha) {
+			return entry.upper;
+		}
+		alpha = max(alpha, (int)entry.lower);
+		beta = min(beta, (int)entry.upper);
+		bestMove = entry.bestMove;
+	}
+
+	const int ALPHA = alpha, BETA = beta;
+	const bool MAXIMIZING = gameState.getNextPlayer() == 1;
+	int bestScore = MAXIMIZING ? SCORE_X_WINS - 1 : SCORE_O_WINS + 1;
+	int bestScoreMove = -1;
+
+	auto moves = gameState.getValidMoves();
+	for (unsigned int i=0;i<=moves.size();i++) {
+		//Tries the best move from the transposition table before the rest
+		int move;
+		if (i == 0) {
+			if (bestMove == -1 || !gameState.isValid(bestMove)) {
+				continue;
+			}
+			move = bestMove;
+		} else {
+			move = moves[i - 1];
+			if (move == bestMove) {
+				continue;
+			}
+		}
+
+		auto undo = gameState.applyMove(move);
+		int score = mSearch(gameState, alpha, beta);
+		gameState.undoMove(undo);
+
+		if (mNodes > mNodeLimit) {
+			return SCORE_TIE;
+		}
+
+		if (MAXIMIZING ? score > bestScore : score < bestScore) {
+			bestScore = score;
+			bestScoreMove = move;
+		}
+		if (MAXIMIZING) {
+			alpha = max(alpha, score);
+		} else {
+			beta = min(beta, score);
+		}
+		if (alpha >= beta) {
+			break;
+		}
+	}
+
+	if (entry.hash != gameState.getHash()) {
+		entry.hash = gameState.getHash();
+		entry.lower = SCORE_X_WINS;
+		entry.upper = SCORE_O_WINS;
+	}
+	if (bestScore <= ALPHA) {
+		entry.upper = (unsigned char)bestScore;
+	} else if (bestScore >= BETA) {
+		entry.lower = (unsigned char)bestScore;
+	} else {
+		entry.lower = (unsigned char)bestScore;
+		entry.upper = (unsigned char)bestScore;
+	}
+	entry.bestMove = (unsigned char)bestScoreMove;
+
+	return bestScore;
+}
+
+#endif
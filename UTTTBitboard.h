@@ -0,0 +1,449 @@
+/* Author: Hanuman Chu
+ *
+ * Creates UTTTBitboard struct which holds one bit for each of the 81 cells of an Ultimate Tic Tac Toe board along with the lookup
+ * tables built at compile time that UTTTGameState uses with it
+ */
+#ifndef UTTT_BITBOARD_H
+#define UTTT_BITBOARD_H
+
+#include <cstdint>
+#ifdef _MSC_VER
+#include <intrin.h>
+#elif defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+/**
+ * @brief mask with one bit set for each cell of a 3 by 3 board
+ */
+const unsigned int MINI_BOARD_MASK = 0x1FF;
+/**
+ * @brief number of mini boards stored in the low word of a UTTTBitboard, the other two are stored in the high word
+ */
+const unsigned int LOW_MINI_BOARDS = 7;
+
+/**
+ * @brief Returns the number of set bits in the given word, counting in parallel within the word when the compiler cannot use a popcount
+ *        instruction since GCC otherwise calls a much slower library function
+ * @param WORD word to count
+ * @return number of set bits
+ */
+inline unsigned int countBits(const uint64_t WORD) {
+#ifdef _MSC_VER
+	return (unsigned int)__popcnt64(WORD);
+#elif defined(__POPCNT__)
+	return (unsigned int)__builtin_popcountll(WORD);
+#else
+	uint64_t counts = WORD - ((WORD >> 1) & 0x5555555555555555ULL);
+	counts = (counts & 0x3333333333333333ULL) + ((counts >> 2) & 0x3333333333333333ULL);
+	counts = (counts + (counts >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	return (unsigned int)((counts * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+/**
+ * @brief Returns the index of the lowest set bit of the given word which must not be zero
+ * @param WORD word to search
+ * @return index of the lowest set bit
+ */
+inline unsigned int lowestBit(const uint64_t WORD) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, WORD);
+	return (unsigned int)index;
+#else
+	return (unsigned int)__builtin_ctzll(WORD);
+#endif
+}
+
+/**
+ * @brief Returns the index of the set bit of the given word with the given number of set bits below it, depositing the bit with pdep
+ *        where BMI2 is available and otherwise narrowing down the byte it is in by counting bits instead of clearing them one at a time
+ * @param word word to search
+ * @param n number of set bits below the one returned, less than the number of set bits in the word
+ * @return index of the bit
+ */
+inline unsigned int selectBit(uint64_t word, unsigned int n) {
+#if !defined(_MSC_VER) && defined(__BMI2__)
+	return lowestBit(_pdep_u64((uint64_t)1 << n, word));
+#else
+	//Positions below 8 are found faster by clearing bits one at a time than by counting, which covers almost every move in a forced 3 by 3 board
+	unsigned int bit = 0;
+	for (unsigned int width=32;width>=8 && n>=8;width/=2) {
+		unsigned int lowCount = countBits(word & (((uint64_t)1 << width) - 1));
+		if (n >= lowCount) {
+			n -= lowCount;
+			word >>= width;
+			bit += width;
+		}
+	}
+	while (n > 0) {
+		word &= word - 1;
+		n--;
+	}
+	return bit + lowestBit(word);
+#endif
+}
+
+/**
+ * @brief Holds lookup tables which convert between moves, which index the board row by row, and bits, which index the board
+ *        mini board by mini board so that each 3 by 3 board is 9 consecutive bits
+ */
+struct UTTTSquareTable {
+	/**
+	 * @brief bit index of each move
+	 */
+	unsigned char moveToBit[81];
+	/**
+	 * @brief move of each bit index
+	 */
+	unsigned char bitToMove[81];
+};
+
+/**
+ * @brief Builds the tables converting between moves and bits
+ * @return table with both conversions filled in
+ */
+constexpr UTTTSquareTable makeSquareTable() {
+	UTTTSquareTable table = {};
+	for (unsigned int move=0;move<81;move++) {
+		unsigned int row = move / 9, col = move % 9;
+		unsigned int bit = ((row / 3) * 3 + col / 3) * 9 + (row % 3) * 3 + col % 3;
+		table.moveToBit[move] = (unsigned char)bit;
+		table.bitToMove[bit] = (unsigned char)move;
+	}
+	return table;
+}
+
+constexpr UTTTSquareTable SQUARE_TABLE = makeSquareTable();
+
+/**
+ * @brief Holds the 8 rotations and reflections of the board, symmetry 2i is the board rotated i times and symmetry 2i+1 is that
+ *        rotation reflected left to right
+ */
+struct UTTTSymmetryTable {
+	/**
+	 * @brief the move each move is sent to by each symmetry
+	 */
+	unsigned char moves[8][81];
+	/**
+	 * @brief the 3 by 3 board each 3 by 3 board is sent to by each symmetry
+	 */
+	unsigned char boards[8][9];
+};
+
+/**
+ * @brief Builds the move and board permutations for every symmetry
+ * @return table with every symmetry filled in
+ */
+constexpr UTTTSymmetryTable makeSymmetryTable() {
+	UTTTSymmetryTable table = {};
+	for (unsigned int move=0;move<81;move++) {
+		unsigned int row = move / 9, col = move % 9;
+		for (unsigned int rotation=0;rotation<4;rotation++) {
+			table.moves[2 * rotation][move] = (unsigned char)(row * 9 + col);
+			table.moves[2 * rotation + 1][move] = (unsigned char)(row * 9 + 8 - col);
+			
+			unsigned int rotatedRow = 8 - col;
+			col = row;
+			row = rotatedRow;
+		}
+	}
+	for (unsigned int symmetry=0;symmetry<8;symmetry++) {
+		for (unsigned int board=0;board<9;board++) {
+			unsigned int center = table.moves[symmetry][(board / 3 * 3 + 1) * 9 + board % 3 * 3 + 1];
+			table.boards[symmetry][board] = (unsigned char)(center / 27 * 3 + center % 9 / 3);
+		}
+	}
+	return table;
+}
+
+constexpr UTTTSymmetryTable SYMMETRY_TABLE = makeSymmetryTable();
+
+/**
+ * @brief Holds whether each 9 bit mask of a 3 by 3 board contains a complete row, column or diagonal
+ */
+struct UTTTWinTable {
+	/**
+	 * @brief true at index mask if the cells in mask complete a line
+	 */
+	bool complete[512];
+	/**
+	 * @brief at index mask, the 9 bit mask of the empty cells which would complete a line if added to the cells in mask
+	 */
+	unsigned short winningCells[512];
+};
+
+/**
+ * @brief Builds the line completion table for every 9 bit mask
+ * @return table with every mask filled in
+ */
+constexpr UTTTWinTable makeWinTable() {
+	const unsigned int LINES[8] = {0x007, 0x038, 0x1C0, 0x049, 0x092, 0x124, 0x111, 0x054};
+	UTTTWinTable table = {};
+	for (unsigned int mask=0;mask<512;mask++) {
+		for (unsigned int line=0;line<8;line++) {
+			if ((mask & LINES[line]) == LINES[line]) {
+				table.complete[mask] = true;
+			}
+		}
+	}
+	for (unsigned int mask=0;mask<512;mask++) {
+		for (unsigned int cell=0;cell<9;cell++) {
+			if ((mask & (1 << cell)) == 0 && table.complete[mask | (1 << cell)]) {
+				table.winningCells[mask] |= (unsigned short)(1 << cell);
+			}
+		}
+	}
+	return table;
+}
+
+constexpr UTTTWinTable WIN_TABLE = makeWinTable();
+
+/**
+ * @brief Holds the random keys XORed together to make the Zobrist hash of a game state
+ */
+struct UTTTZobristTable {
+	/**
+	 * @brief key for each player having a piece on each bit index
+	 */
+	uint64_t cells[2][81];
+	/**
+	 * @brief key for each 3 by 3 board the next move is forced into, with index 9 for when any board can be played
+	 */
+	uint64_t forcedBoards[10];
+	/**
+	 * @brief key included when O is the next player
+	 */
+	uint64_t nextPlayer;
+};
+
+/**
+ * @brief Advances a splitmix64 generator and returns its next output
+ * @param state generator state
+ * @return next pseudorandom number
+ */
+constexpr uint64_t splitMix64(uint64_t& state) {
+	state += 0x9E3779B97F4A7C15ULL;
+	uint64_t result = state;
+	result = (result ^ (result >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	result = (result ^ (result >> 27)) * 0x94D049BB133111EBULL;
+	return result ^ (result >> 31);
+}
+
+/**
+ * @brief Builds the Zobrist keys from a fixed seed so hashes are the same on every run
+ * @return table with every key filled in
+ */
+constexpr UTTTZobristTable makeZobristTable() {
+	UTTTZobristTable table = {};
+	uint64_t state = 0x5554545448415348ULL;
+	for (unsigned int player=0;player<2;player++) {
+		for (unsigned int bit=0;bit<81;bit++) {
+			table.cells[player][bit] = splitMix64(state);
+		}
+	}
+	for (unsigned int board=0;board<10;board++) {
+		table.forcedBoards[board] = splitMix64(state);
+	}
+	table.nextPlayer = splitMix64(state);
+	return table;
+}
+
+constexpr UTTTZobristTable ZOBRIST_TABLE = makeZobristTable();
+
+/**
+ * @brief Returns the winner of a 3 by 3 board given as 9 bit masks with 0 for X, 1 for O, 2 for no winner, and 3 for a tie
+ * @param X_MASK cells taken by X
+ * @param O_MASK cells taken by O
+ * @param DONE_MASK cells which can no longer change
+ * @return winner of board with 0 for X, 1 for O, 2 for no winner, and 3 for a tie
+ */
+inline unsigned int findWinner(const unsigned int X_MASK, const unsigned int O_MASK, const unsigned int DONE_MASK) {
+	if (WIN_TABLE.complete[X_MASK]) {
+		return 0;
+	} else if (WIN_TABLE.complete[O_MASK]) {
+		return 1;
+	} else if (DONE_MASK == MINI_BOARD_MASK) {
+		return 3;
+	}
+	return 2;
+}
+
+struct UTTTBitboard {
+	/**
+	 * @brief bits of mini boards 0 to 6, 9 bits each
+	 */
+	uint64_t low = 0;
+	/**
+	 * @brief bits of mini boards 7 and 8, 9 bits each
+	 */
+	uint64_t high = 0;
+
+	/**
+	 * @brief Returns whether the given bit is set
+	 * @param BIT bit index to check
+	 * @return true if set, false otherwise
+	 */
+	bool test(const unsigned int BIT) const {
+		return BIT < LOW_MINI_BOARDS * 9 ? ((low >> BIT) & 1) != 0 : ((high >> (BIT - LOW_MINI_BOARDS * 9)) & 1) != 0;
+	}
+
+	/**
+	 * @brief Sets the given bit
+	 * @param BIT bit index to set
+	 */
+	void set(const unsigned int BIT) {
+		if (BIT < LOW_MINI_BOARDS * 9) {
+			low |= (uint64_t)1 << BIT;
+		} else {
+			high |= (uint64_t)1 << (BIT - LOW_MINI_BOARDS * 9);
+		}
+	}
+
+	/**
+	 * @brief Clears the given bit
+	 * @param BIT bit index to clear
+	 */
+	void reset(const unsigned int BIT) {
+		if (BIT < LOW_MINI_BOARDS * 9) {
+			low &= ~((uint64_t)1 << BIT);
+		} else {
+			high &= ~((uint64_t)1 << (BIT - LOW_MINI_BOARDS * 9));
+		}
+	}
+
+	/**
+	 * @brief Returns the 9 bits of the given mini board
+	 * @param BOARD index of the mini board
+	 * @return 9 bit mask of the mini board
+	 */
+	unsigned int getMiniBoard(const unsigned int BOARD) const {
+		return BOARD < LOW_MINI_BOARDS ? (unsigned int)(low >> (BOARD * 9)) & MINI_BOARD_MASK : (unsigned int)(high >> ((BOARD - LOW_MINI_BOARDS) * 9)) & MINI_BOARD_MASK;
+	}
+
+	/**
+	 * @brief ORs the given 9 bits into the given mini board
+	 * @param BOARD index of the mini board
+	 * @param MASK 9 bit mask to add
+	 */
+	void addMiniBoard(const unsigned int BOARD, const unsigned int MASK) {
+		if (BOARD < LOW_MINI_BOARDS) {
+			low |= (uint64_t)MASK << (BOARD * 9);
+		} else {
+			high |= (uint64_t)MASK << ((BOARD - LOW_MINI_BOARDS) * 9);
+		}
+	}
+
+	/**
+	 * @brief Returns the number of set bits
+	 * @return number of set bits
+	 */
+	unsigned int count() const {
+		return countBits(low) + countBits(high);
+	}
+
+	/**
+	 * @brief Returns whether no bits are set
+	 * @return true if no bits are set, false otherwise
+	 */
+	bool empty() const {
+		return (low | high) == 0;
+	}
+
+	/**
+	 * @brief Returns the index of the set bit with the given number of set bits below it
+	 * @param INDEX number of set bits below the one returned, less than count
+	 * @return index of the bit
+	 */
+	unsigned int select(const unsigned int INDEX) const {
+		const unsigned int LOW_COUNT = countBits(low);
+		return INDEX < LOW_COUNT ? selectBit(low, INDEX) : selectBit(high, INDEX - LOW_COUNT) + LOW_MINI_BOARDS * 9;
+	}
+
+	/**
+	 * @brief Clears the lowest set bit and returns its index, the bitboard must not be empty
+	 * @return index of the cleared bit
+	 */
+	unsigned int popLowest() {
+		unsigned int bit;
+		if (low != 0) {
+			bit = lowestBit(low);
+			low &= low - 1;
+		} else {
+			bit = lowestBit(high) + LOW_MINI_BOARDS * 9;
+			high &= high - 1;
+		}
+		return bit;
+	}
+
+	/**
+	 * @brief Returns the cells set in either bitboard
+	 * @param OTHER other bitboard
+	 * @return union of both bitboards
+	 */
+	UTTTBitboard operator|(const UTTTBitboard& OTHER) const {
+		UTTTBitboard result;
+		result.low = low | OTHER.low;
+		result.high = high | OTHER.high;
+		return result;
+	}
+
+	/**
+	 * @brief Returns the cells set in both bitboards
+	 * @param OTHER other bitboard
+	 * @return intersection of both bitboards
+	 */
+	UTTTBitboard operator&(const UTTTBitboard& OTHER) const {
+		UTTTBitboard result;
+		result.low = low & OTHER.low;
+		result.high = high & OTHER.high;
+		return result;
+	}
+
+	/**
+	 * @brief Returns the cells not set in this bitboard
+	 * @return complement of this bitboard within the 81 cells
+	 */
+	UTTTBitboard operator~() const {
+		UTTTBitboard result;
+		result.low = ~low & (((uint64_t)1 << (LOW_MINI_BOARDS * 9)) - 1);
+		result.high = ~high & (((uint64_t)1 << ((9 - LOW_MINI_BOARDS) * 9)) - 1);
+		return result;
+	}
+
+	/**
+	 * @brief Returns whether both bitboards have the same cells set
+	 * @param OTHER other bitboard
+	 * @return true if equal, false otherwise
+	 */
+	bool operator==(const UTTTBitboard& OTHER) const {
+		return low == OTHER.low && high == OTHER.high;
+	}
+
+	/**
+	 * @brief Returns whether the bitboards differ in any cell
+	 * @param OTHER other bitboard
+	 * @return true if not equal, false otherwise
+	 */
+	bool operator!=(const UTTTBitboard& OTHER) const {
+		return !(*this == OTHER);
+	}
+};
+
+/**
+ * @brief Returns a bitboard with every cell of the given mini boards set
+ * @param boards 9 bit mask of mini boards
+ * @return bitboard covering those mini boards
+ */
+inline UTTTBitboard expandMiniBoards(unsigned int boards) {
+	UTTTBitboard result;
+	while (boards != 0) {
+		unsigned int board = lowestBit(boards);
+		boards &= boards - 1;
+		result.addMiniBoard(board, MINI_BOARD_MASK);
+	}
+	return result;
+}
+
+#endif
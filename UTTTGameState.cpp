@@ -4,28 +4,39 @@
  */
 #include "UTTTGameState.h"
 
-#include <algorithm>
 #include <fstream>
+#include <stdexcept>
 using namespace std;
 
 UTTTGameState::UTTTGameState() {
-	for (unsigned int i=0;i<MINI_BOARD_SIDE_LENGTH;i++) {
-		for (unsigned int j=0;j<MINI_BOARD_SIDE_LENGTH;j++) {
-			mMiniBoard[i][j] = 2;
-		}
-	}
-	for (unsigned int i=0;i<BOARD_SIDE_LENGTH;i++) {
-		for (unsigned int j=0;j<BOARD_SIDE_LENGTH;j++) {
-			mBoard[i][j] = 2;
-		}
-	}
+	mWonBoards[0] = 0;
+	mWonBoards[1] = 0;
+	mTiedBoards = 0;
 	mInit(-1, 0);
+	mHash = mComputeHash();
 }
 
 UTTTGameState::UTTTGameState(const unsigned int BOARD[BOARD_SIDE_LENGTH][BOARD_SIDE_LENGTH], const unsigned int MINI_BOARD[MINI_BOARD_SIDE_LENGTH][MINI_BOARD_SIDE_LENGTH], const int MOVE, const unsigned int PLAYER) {
-	memcpy(this->mBoard, BOARD, BOARD_ARRAY_SIZE);
-	memcpy(this->mMiniBoard, MINI_BOARD, MINI_BOARD_ARRAY_SIZE);
+	for (unsigned int move=0;move<BOARD_SIDE_LENGTH*BOARD_SIDE_LENGTH;move++) {
+		unsigned int cell = BOARD[move / BOARD_SIDE_LENGTH][move % BOARD_SIDE_LENGTH];
+		if (cell < 2) {
+			mCells[cell].set(SQUARE_TABLE.moveToBit[move]);
+		}
+	}
+	
+	mWonBoards[0] = 0;
+	mWonBoards[1] = 0;
+	mTiedBoards = 0;
+	for (unsigned int board=0;board<MINI_BOARD_SIDE_LENGTH*MINI_BOARD_SIDE_LENGTH;board++) {
+		unsigned int cell = MINI_BOARD[board / MINI_BOARD_SIDE_LENGTH][board % MINI_BOARD_SIDE_LENGTH];
+		if (cell < 2) {
+			mWonBoards[cell] |= 1 << board;
+		} else if (cell == 3) {
+			mTiedBoards |= 1 << board;
+		}
+	}
 	mInit(MOVE,PLAYER);
+	mHash = mComputeHash();
 }
 
 UTTTGameState UTTTGameState::loadState(string filePath) {
@@ -63,69 +74,163 @@ UTTTGameState UTTTGameState::loadState(string filePath) {
 }
 
 UTTTGameState UTTTGameState::getChild(const int MOVE) const {
+	UTTTGameState child = *this;
+	child.applyMove(MOVE);
+	
+	return child;
+}
+
+UTTTUndoRecord UTTTGameState::applyMove(const int MOVE) {
 	if (!isValid(MOVE)) {
 		throw invalid_argument("Invalid move.");
 	}
 	
-	unsigned int copyBoard[BOARD_SIDE_LENGTH][BOARD_SIDE_LENGTH];
-	memcpy(copyBoard, mBoard, BOARD_ARRAY_SIZE);
-	unsigned int copyMiniBoard[MINI_BOARD_SIDE_LENGTH][MINI_BOARD_SIDE_LENGTH];
-	memcpy(copyMiniBoard, mMiniBoard, MINI_BOARD_ARRAY_SIZE);
-	mEditBoard(copyBoard, copyMiniBoard, MOVE, mNextPlayer);
+	UTTTUndoRecord undo;
+	undo.move = MOVE;
+	undo.prevMove = mPrevMove;
+	undo.wonBoards[0] = mWonBoards[0];
+	undo.wonBoards[1] = mWonBoards[1];
+	undo.tiedBoards = mTiedBoards;
+	undo.validMoves = mValidMoves;
+	undo.end = mEnd;
+	undo.forcedBoard = mForcedBoard;
+	undo.hash = mHash;
+	
+	mHash ^= ZOBRIST_TABLE.cells[mNextPlayer][SQUARE_TABLE.moveToBit[MOVE]] ^ ZOBRIST_TABLE.forcedBoards[mForcedBoard] ^ ZOBRIST_TABLE.nextPlayer;
+	mEditBoard(MOVE, mNextPlayer);
+	mInit(MOVE, 1-mNextPlayer);
+	mHash ^= ZOBRIST_TABLE.forcedBoards[mForcedBoard];
 	
-	return UTTTGameState(copyBoard, copyMiniBoard, MOVE, 1-mNextPlayer);
+	return undo;
+}
+
+void UTTTGameState::undoMove(const UTTTUndoRecord& UNDO) {
+	mNextPlayer = 1-mNextPlayer;
+	mCells[mNextPlayer].reset(SQUARE_TABLE.moveToBit[UNDO.move]);
+	mPrevMove = UNDO.prevMove;
+	mWonBoards[0] = UNDO.wonBoards[0];
+	mWonBoards[1] = UNDO.wonBoards[1];
+	mTiedBoards = UNDO.tiedBoards;
+	mValidMoves = UNDO.validMoves;
+	mEnd = UNDO.end;
+	mForcedBoard = UNDO.forcedBoard;
+	mHash = UNDO.hash;
+}
+
+void UTTTGameState::applyPlayoutMove(const int MOVE) {
+	mEditBoard(MOVE, mNextPlayer);
+	mInit(MOVE, 1-mNextPlayer);
 }
 
 bool UTTTGameState::isValid(const int MOVE) const {
-	return find(mValidMoves.begin(), mValidMoves.end(), MOVE) != mValidMoves.end();
+	return MOVE >= 0 && MOVE < (int)(BOARD_SIDE_LENGTH * BOARD_SIDE_LENGTH) && mValidMoves.test(SQUARE_TABLE.moveToBit[MOVE]);
 }
 
 string UTTTGameState::getKey() const {
 	string key;
 	
-	for (unsigned int i=0;i<BOARD_SIDE_LENGTH;i++) {
-		for (unsigned int j=0;j<BOARD_SIDE_LENGTH;j++) {
-			key += (char)mBoard[i][j];
-		}
+	for (char cell:getBoard()) {
+		key += cell;
 	}
 	key += (char)mPrevMove;
 	
 	return key;
 }
 
+uint64_t UTTTGameState::getHash() const {
+	return mHash;
+}
+
+UTTTGameState UTTTGameState::getSymmetry(const unsigned int SYMMETRY) const {
+	UTTTGameState symmetric = *this;
+	for (unsigned int player=0;player<2;player++) {
+		symmetric.mCells[player] = UTTTBitboard();
+		UTTTBitboard cells = mCells[player];
+		while (!cells.empty()) {
+			symmetric.mCells[player].set(SQUARE_TABLE.moveToBit[SYMMETRY_TABLE.moves[SYMMETRY][SQUARE_TABLE.bitToMove[cells.popLowest()]]]);
+		}
+	}
+	
+	symmetric.mWonBoards[0] = 0;
+	symmetric.mWonBoards[1] = 0;
+	symmetric.mTiedBoards = 0;
+	for (unsigned int board=0;board<MINI_BOARD_SIDE_LENGTH*MINI_BOARD_SIDE_LENGTH;board++) {
+		unsigned int symmetricBoard = SYMMETRY_TABLE.boards[SYMMETRY][board];
+		symmetric.mWonBoards[0] |= ((mWonBoards[0] >> board) & 1) << symmetricBoard;
+		symmetric.mWonBoards[1] |= ((mWonBoards[1] >> board) & 1) << symmetricBoard;
+		symmetric.mTiedBoards |= ((mTiedBoards >> board) & 1) << symmetricBoard;
+	}
+	
+	symmetric.mInit(mPrevMove == -1 ? -1 : SYMMETRY_TABLE.moves[SYMMETRY][mPrevMove], mNextPlayer);
+	symmetric.mHash = symmetric.mComputeHash();
+	
+	return symmetric;
+}
+
+uint64_t UTTTGameState::getSymmetricHash(const unsigned int SYMMETRY) const {
+	uint64_t hash = ZOBRIST_TABLE.forcedBoards[mForcedBoard == 9 ? 9 : SYMMETRY_TABLE.boards[SYMMETRY][mForcedBoard]];
+	if (mNextPlayer == 1) {
+		hash ^= ZOBRIST_TABLE.nextPlayer;
+	}
+	for (unsigned int player=0;player<2;player++) {
+		UTTTBitboard cells = mCells[player];
+		while (!cells.empty()) {
+			hash ^= ZOBRIST_TABLE.cells[player][SQUARE_TABLE.moveToBit[SYMMETRY_TABLE.moves[SYMMETRY][SQUARE_TABLE.bitToMove[cells.popLowest()]]]];
+		}
+	}
+	
+	return hash;
+}
+
+unsigned int UTTTGameState::getCanonicalSymmetry() const {
+	uint64_t canonicalHash;
+	return mFindCanonical(canonicalHash);
+}
+
+uint64_t UTTTGameState::getCanonicalHash() const {
+	uint64_t canonicalHash;
+	mFindCanonical(canonicalHash);
+	return canonicalHash;
+}
+
+int UTTTGameState::getSymmetricMove(const int MOVE, const unsigned int SYMMETRY) {
+	return SYMMETRY_TABLE.moves[SYMMETRY][MOVE];
+}
+
 vector<pair<vector<float>, vector<float>>> UTTTGameState::getSymmetries(const vector<float> PROBS) const {
 	if (PROBS.size() < BOARD_SIDE_LENGTH * BOARD_SIDE_LENGTH) {
 		throw invalid_argument("Input vector is too small.");
 	}
 	
-	vector<pair<vector<float>, vector<float>>> symmetries;
+	float boards[SYMMETRY_COUNT * BOARD_SIDE_LENGTH * BOARD_SIDE_LENGTH];
+	float probs[SYMMETRY_COUNT * BOARD_SIDE_LENGTH * BOARD_SIDE_LENGTH];
+	getSymmetries(PROBS.data(), boards, probs);
 	
-	vector<float> curBoard = getBoard(), reflectedBoard = curBoard;
-	vector<float> curProbs = PROBS, reflectedProbs = curProbs;
-	
-	for (int i=0;i<4;i++) {
-		if (i != 0) {
-			vector<float> originalBoard = curBoard;
-			vector<float> originalProbs = curProbs;
-			for (unsigned int j=0;j<BOARD_SIDE_LENGTH*BOARD_SIDE_LENGTH;j++) {
-				int originalPos = (j % BOARD_SIDE_LENGTH) * BOARD_SIDE_LENGTH + (BOARD_SIDE_LENGTH - 1 - j / BOARD_SIDE_LENGTH);
-				curBoard[j] = originalBoard[originalPos];
-				curProbs[j] = originalProbs[originalPos];
-			}
-		}
-		for (unsigned int j=0;j<BOARD_SIDE_LENGTH*BOARD_SIDE_LENGTH;j++) {
-			int reflectedPos = (j / BOARD_SIDE_LENGTH) * BOARD_SIDE_LENGTH + (BOARD_SIDE_LENGTH - 1 - j % BOARD_SIDE_LENGTH);
-			reflectedBoard[reflectedPos] = curBoard[j];
-			reflectedProbs[reflectedPos] = curProbs[j];
-		}
-		
-		symmetries.push_back({curBoard,curProbs});
-		symmetries.push_back({reflectedBoard,reflectedProbs});
+	vector<pair<vector<float>, vector<float>>> symmetries;
+	for (unsigned int symmetry=0;symmetry<SYMMETRY_COUNT;symmetry++) {
+		const float* BOARD = boards + symmetry * BOARD_SIDE_LENGTH * BOARD_SIDE_LENGTH;
+		const float* SYMMETRIC_PROBS = probs + symmetry * BOARD_SIDE_LENGTH * BOARD_SIDE_LENGTH;
+		symmetries.push_back({vector<float>(BOARD, BOARD + BOARD_SIDE_LENGTH * BOARD_SIDE_LENGTH), vector<float>(SYMMETRIC_PROBS, SYMMETRIC_PROBS + BOARD_SIDE_LENGTH * BOARD_SIDE_LENGTH)});
 	}
 	
 	return symmetries;
 }
 
+void UTTTGameState::getSymmetries(const float* PROBS, float* boards, float* probs) const {
+	float board[BOARD_SIDE_LENGTH * BOARD_SIDE_LENGTH];
+	mFillBoard(board);
+	
+	for (unsigned int symmetry=0;symmetry<SYMMETRY_COUNT;symmetry++) {
+		const unsigned char* MOVES = SYMMETRY_TABLE.moves[symmetry];
+		float* symmetricBoard = boards + symmetry * BOARD_SIDE_LENGTH * BOARD_SIDE_LENGTH;
+		float* symmetricProbs = probs + symmetry * BOARD_SIDE_LENGTH * BOARD_SIDE_LENGTH;
+		for (unsigned int move=0;move<BOARD_SIDE_LENGTH*BOARD_SIDE_LENGTH;move++) {
+			symmetricBoard[MOVES[move]] = board[move];
+			symmetricProbs[MOVES[move]] = PROBS[move];
+		}
+	}
+}
+
 void UTTTGameState::saveState(const string FILE_PATH) const {
 	ofstream fout(FILE_PATH);
 	
@@ -134,16 +239,18 @@ void UTTTGameState::saveState(const string FILE_PATH) const {
 		throw invalid_argument("Could not open the file for writing.");
 	}
 	
+	vector<float> board = getBoard();
 	for (unsigned int i=0;i<BOARD_SIDE_LENGTH;i++) {
 		for (unsigned int j=0;j<BOARD_SIDE_LENGTH;j++) {
-			fout << mBoard[i][j] << " ";
+			fout << board[i * BOARD_SIDE_LENGTH + j] << " ";
 		}
 		fout << endl;
 	}
 	
+	vector<float> miniBoard = getMiniBoard();
 	for (unsigned int i=0;i<MINI_BOARD_SIDE_LENGTH;i++) {
 		for (unsigned int j=0;j<MINI_BOARD_SIDE_LENGTH;j++) {
-			fout << mMiniBoard[i][j] << " ";
+			fout << miniBoard[i * MINI_BOARD_SIDE_LENGTH + j] << " ";
 		}
 		fout << endl;
 	}
@@ -157,26 +264,92 @@ void UTTTGameState::saveState(const string FILE_PATH) const {
 	fout.close();
 }
 
-vector<int> UTTTGameState::getValidMoves() const {
-	return mValidMoves;
+UTTTMoveList UTTTGameState::getValidMoves() const {
+	UTTTMoveList moves;
+	UTTTBitboard validMoves = mValidMoves;
+	while (!validMoves.empty()) {
+		moves.push_back(SQUARE_TABLE.bitToMove[validMoves.popLowest()]);
+	}
+	
+	return moves;
+}
+
+unsigned int UTTTGameState::getValidMoveCount() const {
+	return mValidMoves.count();
+}
+
+int UTTTGameState::getValidMove(unsigned int index) const {
+	return SQUARE_TABLE.bitToMove[mValidMoves.select(index)];
+}
+
+unsigned int UTTTGameState::getBoardWinningMoveCount() const {
+	return mGetBoardWinningCells().count();
+}
+
+int UTTTGameState::getBoardWinningMove(unsigned int index) const {
+	return SQUARE_TABLE.bitToMove[mGetBoardWinningCells().select(index)];
+}
+
+unsigned int UTTTGameState::getEmptyCount() const {
+	return mGetAllEmpty().count();
 }
 
 vector<float> UTTTGameState::getBoard() const {
-	vector<float> board;
-	for (unsigned int i=0;i<BOARD_SIDE_LENGTH;i++) {
-		for (unsigned int j=0;j<BOARD_SIDE_LENGTH;j++) {
-			board.push_back(mBoard[i][j]);
+	vector<float> board(BOARD_SIDE_LENGTH * BOARD_SIDE_LENGTH);
+	mFillBoard(board.data());
+	
+	return board;
+}
+
+void UTTTGameState::encode(float* input, const unsigned int FLAGS) const {
+	mFillBoard(input);
+	input += BOARD_SIDE_LENGTH * BOARD_SIDE_LENGTH;
+	
+	if (FLAGS & ENCODE_NEXT_PLAYER) {
+		for (unsigned int move=0;move<BOARD_SIDE_LENGTH*BOARD_SIDE_LENGTH;move++) {
+			input[move] = (float)mNextPlayer;
 		}
+		input += BOARD_SIDE_LENGTH * BOARD_SIDE_LENGTH;
 	}
 	
-	return board;
+	if (FLAGS & ENCODE_VALID_MOVES) {
+		for (unsigned int move=0;move<BOARD_SIDE_LENGTH*BOARD_SIDE_LENGTH;move++) {
+			input[move] = mValidMoves.test(SQUARE_TABLE.moveToBit[move]) ? 1.0f : 0.0f;
+		}
+		input += BOARD_SIDE_LENGTH * BOARD_SIDE_LENGTH;
+	}
+	
+	if (FLAGS & ENCODE_WON_BOARDS) {
+		for (unsigned int move=0;move<BOARD_SIDE_LENGTH*BOARD_SIDE_LENGTH;move++) {
+			unsigned int board = SQUARE_TABLE.moveToBit[move] / 9;
+			if (mWonBoards[0] & (1 << board)) {
+				input[move] = 0.0f;
+			} else if (mWonBoards[1] & (1 << board)) {
+				input[move] = 1.0f;
+			} else if (mTiedBoards & (1 << board)) {
+				input[move] = 3.0f;
+			} else {
+				input[move] = 2.0f;
+			}
+		}
+	}
+}
+
+unsigned int UTTTGameState::getEncodedPlanes(const unsigned int FLAGS) {
+	return 1 + ((FLAGS & ENCODE_NEXT_PLAYER) != 0) + ((FLAGS & ENCODE_VALID_MOVES) != 0) + ((FLAGS & ENCODE_WON_BOARDS) != 0);
 }
 
 vector<float> UTTTGameState::getMiniBoard() const {
 	vector<float> miniBoard;
-	for (unsigned int i=0;i<MINI_BOARD_SIDE_LENGTH;i++) {
-		for (unsigned int j=0;j<MINI_BOARD_SIDE_LENGTH;j++) {
-			miniBoard.push_back(mMiniBoard[i][j]);
+	for (unsigned int board=0;board<MINI_BOARD_SIDE_LENGTH*MINI_BOARD_SIDE_LENGTH;board++) {
+		if (mWonBoards[0] & (1 << board)) {
+			miniBoard.push_back(0.0f);
+		} else if (mWonBoards[1] & (1 << board)) {
+			miniBoard.push_back(1.0f);
+		} else if (mTiedBoards & (1 << board)) {
+			miniBoard.push_back(3.0f);
+		} else {
+			miniBoard.push_back(2.0f);
 		}
 	}
 	
@@ -194,119 +367,101 @@ unsigned int UTTTGameState::getEnd() const {
 void UTTTGameState::mInit(const int MOVE, const unsigned int PLAYER) {
 	mPrevMove = MOVE;
 	mNextPlayer = PLAYER;
-	mEnd = mFindWinner(mMiniBoard);
+	mEnd = findWinner(mWonBoards[0], mWonBoards[1], mWonBoards[0] | mWonBoards[1] | mTiedBoards);
 	if (mEnd == 2) {
 		mGenerateValidMoves();
 	} else {
-		mValidMoves = {};
+		mValidMoves = UTTTBitboard();
+		mForcedBoard = 9;
 	}
 }
 
-void UTTTGameState::mGenerateValidMoves() {
-	mValidMoves = {};
+void UTTTGameState::mFillBoard(float* board) const {
+	for (unsigned int move=0;move<BOARD_SIDE_LENGTH*BOARD_SIDE_LENGTH;move++) {
+		board[move] = 2.0f;
+	}
+	for (unsigned int player=0;player<2;player++) {
+		UTTTBitboard cells = mCells[player];
+		while (!cells.empty()) {
+			board[SQUARE_TABLE.bitToMove[cells.popLowest()]] = (float)player;
+		}
+	}
+}
+
+uint64_t UTTTGameState::mComputeHash() const {
+	uint64_t hash = ZOBRIST_TABLE.forcedBoards[mForcedBoard];
+	if (mNextPlayer == 1) {
+		hash ^= ZOBRIST_TABLE.nextPlayer;
+	}
+	for (unsigned int player=0;player<2;player++) {
+		UTTTBitboard cells = mCells[player];
+		while (!cells.empty()) {
+			hash ^= ZOBRIST_TABLE.cells[player][cells.popLowest()];
+		}
+	}
 	
+	return hash;
+}
+
+void UTTTGameState::mGenerateValidMoves() {
+	mForcedBoard = 9;
 	if (mPrevMove == -1) {
 		mValidMoves = mGetAllEmpty();
 		return;
 	}
 	
-	unsigned int boardX = mPrevMove%3;
-	unsigned int boardY = (mPrevMove/9)%3;
-	if (mMiniBoard[boardY][boardX] != 2) {
+	unsigned int board = SQUARE_TABLE.moveToBit[mPrevMove] % 9;
+	if ((mWonBoards[0] | mWonBoards[1] | mTiedBoards) & (1 << board)) {
 		mValidMoves = mGetAllEmpty();
 		return;
 	}
 	
-	for (unsigned int i=boardX*3;i<3+boardX*3;i++) {
-		for (unsigned int j=boardY*3;j<3+boardY*3;j++) {
-			if (mBoard[j][i] == 2) {
-				mValidMoves.push_back(j * BOARD_SIDE_LENGTH + i);
-			}
-		}
-	}
+	mForcedBoard = board;
+	mValidMoves = UTTTBitboard();
+	mValidMoves.addMiniBoard(board, ~((mCells[0] | mCells[1]).getMiniBoard(board)) & MINI_BOARD_MASK);
 }
 
-vector<int> UTTTGameState::mGetAllEmpty() const {
-	vector<int> moves;
-	for (unsigned int boardX=0;boardX<3;boardX++) {
-		for (unsigned int boardY=0;boardY<3;boardY++) {
-			if (mMiniBoard[boardY][boardX] == 2) {
-				for (unsigned int i=boardX*3;i<3+boardX*3;i++) {
-					for (unsigned int j=boardY*3;j<3+boardY*3;j++) {
-						if (mBoard[j][i] == 2) {
-							moves.push_back(j * BOARD_SIDE_LENGTH + i);
-						}
-					}
-				}
-			}
-		}
+UTTTBitboard UTTTGameState::mGetAllEmpty() const {
+	unsigned int openBoards = ~(mWonBoards[0] | mWonBoards[1] | mTiedBoards) & MINI_BOARD_MASK;
+	return ~(mCells[0] | mCells[1]) & expandMiniBoards(openBoards);
+}
+
+UTTTBitboard UTTTGameState::mGetBoardWinningCells() const {
+	UTTTBitboard winningCells;
+	unsigned int boards = mForcedBoard == 9 ? ~(mWonBoards[0] | mWonBoards[1] | mTiedBoards) & MINI_BOARD_MASK : 1 << mForcedBoard;
+	while (boards != 0) {
+		unsigned int board = lowestBit(boards);
+		boards &= boards - 1;
+		winningCells.addMiniBoard(board, WIN_TABLE.winningCells[mCells[mNextPlayer].getMiniBoard(board)] & mValidMoves.getMiniBoard(board));
 	}
-	return moves;
+	
+	return winningCells;
 }
 
-void UTTTGameState::mEditBoard(unsigned int (&board)[BOARD_SIDE_LENGTH][BOARD_SIDE_LENGTH], unsigned int (&miniBoard)[MINI_BOARD_SIDE_LENGTH][MINI_BOARD_SIDE_LENGTH], const int MOVE, const unsigned int PLAYER) {
-	board[MOVE / BOARD_SIDE_LENGTH][MOVE % BOARD_SIDE_LENGTH] = PLAYER;
-	unsigned int boardX = (MOVE % BOARD_SIDE_LENGTH ) / 3;
-	unsigned int boardY = (MOVE / BOARD_SIDE_LENGTH) / 3;
+void UTTTGameState::mEditBoard(const int MOVE, const unsigned int PLAYER) {
+	unsigned int bit = SQUARE_TABLE.moveToBit[MOVE];
+	mCells[PLAYER].set(bit);
 	
-	unsigned int smallBoard[MINI_BOARD_SIDE_LENGTH][MINI_BOARD_SIDE_LENGTH];
-	for (unsigned int j=boardY*3;j<boardY*3+3;j++) {
-		for (unsigned int i=boardX*3;i<boardX*3+3;i++) {
-			smallBoard[j-boardY*3][i-boardX*3] = board[j][i];
-		}
+	unsigned int board = bit / 9;
+	unsigned int xMask = mCells[0].getMiniBoard(board), oMask = mCells[1].getMiniBoard(board);
+	unsigned int result = findWinner(xMask, oMask, xMask | oMask);
+	if (result < 2) {
+		mWonBoards[result] |= 1 << board;
+	} else if (result == 3) {
+		mTiedBoards |= 1 << board;
 	}
-	
-	unsigned int result = mFindWinner(smallBoard);
-	miniBoard[boardY][boardX] = result;
-}
-
-unsigned int UTTTGameState::mFindWinner(const unsigned int (&MINI_BOARD)[MINI_BOARD_SIDE_LENGTH][MINI_BOARD_SIDE_LENGTH]) {
-	int sums[5] = {0,0,0,0,0};
-	bool tie = true;
-	for (unsigned int i=0;i<3;i++) {
-		int rowsum = 0;
-		for (unsigned int j=0;j<3;j++) {
-			unsigned int cell = MINI_BOARD[i][j];
-			switch (cell) {
-				case 0:
-					rowsum++;
-					sums[j]++;
-					if (i == j) {
-						sums[3]++;
-					}
-					if (i + j + 1 == 3) {
-						sums[4]++;
-					}
-					break;
-				case 1:
-					rowsum--;
-					sums[j]--;
-					if (i == j) {
-						sums[3]--;
-					}
-					if (i + j + 1 == 3) {
-						sums[4]--;
-					}
-					break;
-				case 2:
-					tie = false;
-					break;
-			}
-		}
-		
-		if (rowsum == 3) {
-			return 0;
-		} else if (rowsum == -3) {
-			return 1;
+}
+
+unsigned int UTTTGameState::mFindCanonical(uint64_t& canonicalHash) const {
+	unsigned int canonicalSymmetry = 0;
+	canonicalHash = mHash;
+	for (unsigned int symmetry=1;symmetry<8;symmetry++) {
+		uint64_t hash = getSymmetricHash(symmetry);
+		if (hash < canonicalHash) {
+			canonicalHash = hash;
+			canonicalSymmetry = symmetry;
 		}
 	}
 	
-	if (find(sums, sums + 5, 3) != sums + 5) {
-		return 0;
-	} else if (find(sums, sums + 5, -3) != sums + 5) {
-		return 1;
-	} else if (tie) {
-		return 3;
-	}
-	return 2;
-}
\ No newline at end of file
+	return canonicalSymmetry;
+}
@@ -5,14 +5,59 @@
 #ifndef UTTT_GAME_STATE_H
 #define UTTT_GAME_STATE_H
 
+#include "UTTTBitboard.h"
+#include "UTTTMoveList.h"
+
 #include <string>
 #include <vector>
 using namespace std;
 
 const unsigned int BOARD_SIDE_LENGTH = 9;
 const unsigned int MINI_BOARD_SIDE_LENGTH = 3;
-const unsigned int BOARD_ARRAY_SIZE = BOARD_SIDE_LENGTH * BOARD_SIDE_LENGTH * sizeof(unsigned int);
-const unsigned int MINI_BOARD_ARRAY_SIZE = MINI_BOARD_SIDE_LENGTH * MINI_BOARD_SIDE_LENGTH * sizeof(unsigned int);
+const unsigned int SYMMETRY_COUNT = 8;
+
+//Flags for extra planes written by encode after the board plane, in this order
+const unsigned int ENCODE_NEXT_PLAYER = 1;
+const unsigned int ENCODE_VALID_MOVES = 2;
+const unsigned int ENCODE_WON_BOARDS = 4;
+
+/**
+ * @brief Holds everything UTTTGameState::undoMove needs to restore the state from before UTTTGameState::applyMove
+ */
+struct UTTTUndoRecord {
+	/**
+	 * @brief the move that was applied
+	 */
+	int move;
+	/**
+	 * @brief the move made before the applied move
+	 */
+	int prevMove;
+	/**
+	 * @brief the 3 by 3 boards won by each player before the move
+	 */
+	unsigned int wonBoards[2];
+	/**
+	 * @brief the tied 3 by 3 boards before the move
+	 */
+	unsigned int tiedBoards;
+	/**
+	 * @brief the valid moves before the move
+	 */
+	UTTTBitboard validMoves;
+	/**
+	 * @brief the end state before the move
+	 */
+	unsigned int end;
+	/**
+	 * @brief the 3 by 3 board the move was forced into, 9 if any board could be played
+	 */
+	unsigned int forcedBoard;
+	/**
+	 * @brief the Zobrist hash before the move
+	 */
+	uint64_t hash;
+};
 
 class UTTTGameState {
 public:
@@ -46,6 +91,27 @@ public:
 	 */
     UTTTGameState getChild(const int MOVE) const;
 	
+	/**
+	 * @brief Plays a given move on this game state and returns what is needed to take it back
+	 * @param MOVE next move
+	 * @return record to pass to undoMove
+	 * @throws invalid_argument if move is invalid
+	 */
+	UTTTUndoRecord applyMove(const int MOVE);
+	
+	/**
+	 * @brief Takes back the move described by a record returned from the most recent applyMove that has not been undone
+	 * @param UNDO record of the move to take back
+	 */
+	void undoMove(const UTTTUndoRecord& UNDO);
+	
+	/**
+	 * @brief Plays a given move without checking it, recording how to undo it or updating the hash, for random playouts which only need
+	 *        the result of the game, so getHash and anything built on it are wrong afterwards
+	 * @param MOVE next move, which has to be valid
+	 */
+	void applyPlayoutMove(const int MOVE);
+	
 	/**
 	 * @brief Checks if a given move is valid
 	 * @param MOVE move to check
@@ -59,6 +125,48 @@ public:
 	 */
 	string getKey() const;
 	
+	/**
+	 * @brief Returns a 64 bit Zobrist hash of the cells, the 3 by 3 board the next move is forced into and the next player which is kept up to
+	 *        date as moves are applied
+	 * @return hash of this object
+	 */
+	uint64_t getHash() const;
+	
+	/**
+	 * @brief Returns this game state rotated and reflected by a given symmetry, where symmetry 2i is the board rotated i times and
+	 *        symmetry 2i+1 is that rotation reflected left to right like in getSymmetries
+	 * @param SYMMETRY symmetry from 0 to 7 to apply
+	 * @return symmetric game state
+	 */
+	UTTTGameState getSymmetry(const unsigned int SYMMETRY) const;
+	
+	/**
+	 * @brief Returns the hash the game state given by getSymmetry would have without building it
+	 * @param SYMMETRY symmetry from 0 to 7 to apply
+	 * @return hash of the symmetric game state
+	 */
+	uint64_t getSymmetricHash(const unsigned int SYMMETRY) const;
+	
+	/**
+	 * @brief Returns the symmetry which turns this game state into its canonical form, the symmetric game state with the smallest hash
+	 * @return symmetry from 0 to 7 which gives the canonical form
+	 */
+	unsigned int getCanonicalSymmetry() const;
+	
+	/**
+	 * @brief Returns the hash of the canonical form of this game state which is the same for all 8 symmetric game states
+	 * @return hash of the canonical form
+	 */
+	uint64_t getCanonicalHash() const;
+	
+	/**
+	 * @brief Returns the move a given move is sent to by a given symmetry
+	 * @param MOVE move to transform
+	 * @param SYMMETRY symmetry from 0 to 7 to apply
+	 * @return transformed move
+	 */
+	static int getSymmetricMove(const int MOVE, const unsigned int SYMMETRY);
+	
 	/**
 	 * @brief Returns a vector of pairs of boards and move probabilities generated from the current board and the given move probabilities' symmetric equivalents
 	 * @param PROBS vector of move probabilities
@@ -67,6 +175,15 @@ public:
 	 */
 	vector<pair<vector<float>, vector<float>>> getSymmetries(const vector<float> PROBS) const;
 	
+	/**
+	 * @brief Writes the current board and the given move probabilities under each of the 8 symmetries into caller provided buffers, in the
+	 *        same order as the vector version, so that symmetry i of the board starts at boards + 81 * i and likewise for probs
+	 * @param PROBS 81 move probabilities
+	 * @param boards buffer of at least 8 * 81 floats to write the boards into
+	 * @param probs buffer of at least 8 * 81 floats to write the move probabilities into
+	 */
+	void getSymmetries(const float* PROBS, float* boards, float* probs) const;
+	
 	/**
 	 * @brief Saves this object's game information in an easy to read format at a given file path
 	 * @param FILE_PATH file path to save UTTTGameState in 
@@ -75,10 +192,43 @@ public:
     void saveState(const string FILE_PATH) const;
 	
 	/**
-	 * @brief Returns vector with all valid moves
+	 * @brief Returns move list with all valid moves
 	 * @return all valid moves
 	 */
-    vector<int> getValidMoves() const;
+    UTTTMoveList getValidMoves() const;
+	
+	/**
+	 * @brief Returns the number of valid moves without building a move list
+	 * @return number of valid moves
+	 */
+	unsigned int getValidMoveCount() const;
+	
+	/**
+	 * @brief Returns the valid move at a given position in the order getValidMoves lists them without building a move list
+	 * @param index position of the move, less than getValidMoveCount
+	 * @return valid move at that position
+	 */
+	int getValidMove(unsigned int index) const;
+	
+	/**
+	 * @brief Returns the number of valid moves that win a 3 by 3 board for the next player without building a move list
+	 * @return number of valid moves which win a 3 by 3 board
+	 */
+	unsigned int getBoardWinningMoveCount() const;
+	
+	/**
+	 * @brief Returns the move that wins a 3 by 3 board at a given position in the order getValidMoves lists them without building a move
+	 *        list
+	 * @param index position of the move, less than getBoardWinningMoveCount
+	 * @return valid move which wins a 3 by 3 board at that position
+	 */
+	int getBoardWinningMove(unsigned int index) const;
+	
+	/**
+	 * @brief Returns the number of empty cells in unfinished 3 by 3 boards, which bounds how many moves are left in the game
+	 * @return number of empty cells that can still be played
+	 */
+	unsigned int getEmptyCount() const;
 	
 	/**
 	 * @brief Returns the current board in a single row, with each row in the board after the previous
@@ -86,6 +236,22 @@ public:
 	 */
 	vector<float> getBoard() const;
 	
+	/**
+	 * @brief Writes the neural network input for this object into a buffer of 81 floats per plane in a single pass. The first plane is
+	 *        the board as given by getBoard, followed by a plane for each flag that is set: the next player in every cell, 1 in cells that
+	 *        are valid moves and 0 elsewhere, and each cell holding the value getMiniBoard gives its 3 by 3 board
+	 * @param input buffer of getEncodedPlanes(FLAGS) * 81 floats to write into, such as the memory of a preallocated tensor
+	 * @param FLAGS combination of ENCODE_NEXT_PLAYER, ENCODE_VALID_MOVES and ENCODE_WON_BOARDS
+	 */
+	void encode(float* input, const unsigned int FLAGS) const;
+	
+	/**
+	 * @brief Returns the number of 81 float planes encode writes for the given flags
+	 * @param FLAGS combination of ENCODE_NEXT_PLAYER, ENCODE_VALID_MOVES and ENCODE_WON_BOARDS
+	 * @return number of planes
+	 */
+	static unsigned int getEncodedPlanes(const unsigned int FLAGS);
+	
 	/**
 	 * @brief Returns the current mini board in a single row, with each row in the mini board after the previous
 	 * @return current mini board
@@ -105,63 +271,92 @@ public:
 	unsigned int getEnd() const;
 private:
 	/**
-	 * @brief holds the state of the overall board with a 0 for X, 1 for O, and 2 for empty cells
+	 * @brief holds the cells taken by each player with index 0 for X and 1 for O
 	 */
-    unsigned int mBoard[BOARD_SIDE_LENGTH][BOARD_SIDE_LENGTH];
+	UTTTBitboard mCells[2];
 	/**
-	 * @brief holds the state of the 9 3 by 3 boards with a 0 for X, 1 for O, 2 for unfinished boards, and 3 for ties
+	 * @brief holds the 3 by 3 boards won by each player as 9 bit masks with index 0 for X and 1 for O
 	 */
-    unsigned int mMiniBoard[MINI_BOARD_SIDE_LENGTH][MINI_BOARD_SIDE_LENGTH];
-    /**
+	unsigned int mWonBoards[2];
+	/**
+	 * @brief holds the 3 by 3 boards which are full without a winner as a 9 bit mask
+	 */
+	unsigned int mTiedBoards;
+	/**
 	 * @brief holds the move made before this game state. -1 if no moves have been made
 	 */
 	int mPrevMove;
-    /**
+	/**
 	 * @brief the next player with a 0 for X and a 1 for O
 	 */
 	unsigned int mNextPlayer;
 	/**
-	 * @brief holds the valid moves that can be made from this object
+	 * @brief holds the cells of the valid moves that can be made from this object
 	 */
-	vector<int> mValidMoves;
-    /**
+	UTTTBitboard mValidMoves;
+	/**
 	 * @brief the end state of this object with a 0 if X won, 1 if O won, 2 if the game has not ended, and 3 if the game is a tie
 	 */
 	unsigned int mEnd;
+	/**
+	 * @brief the 3 by 3 board the next move is forced into, 9 if any board can be played
+	 */
+	unsigned int mForcedBoard;
+	/**
+	 * @brief Zobrist hash of this object
+	 */
+	uint64_t mHash;
 	
 	/**
 	 * @brief Initializes a new UTTTGameState with the previous move and next player
 	 * @param MOVE the previous move
 	 * @param PLAYER the next player
 	 */
-    void mInit(const int MOVE, const unsigned int PLAYER);
+	void mInit(const int MOVE, const unsigned int PLAYER);
+	
+	/**
+	 * @brief Writes the current board into a buffer of 81 floats with the same values as getBoard
+	 * @param board buffer to write into
+	 */
+	void mFillBoard(float* board) const;
+	
+	/**
+	 * @brief Returns the Zobrist hash of this object computed from scratch
+	 * @return hash of this object
+	 */
+	uint64_t mComputeHash() const;
 	
 	/**
-	 * @brief Initializes validMoves with all valid moves
+	 * @brief Initializes validMoves with all valid moves and sets the forced 3 by 3 board
 	 */
-    void mGenerateValidMoves();
+	void mGenerateValidMoves();
 	
 	/**
-	 * @brief Returns a vector with every empty cell on the board
+	 * @brief Returns a bitboard with every empty cell in an unfinished 3 by 3 board
 	 * @return all empty cells 
 	 */
-    vector<int> mGetAllEmpty() const;
+	UTTTBitboard mGetAllEmpty() const;
 	
 	/**
-	 * @brief Applies a given move for a given player on the given board and mini board
-	 * @param board board to edit
-	 * @param miniBoard mini board to edit
-	 * @param MOVE the current move
-	 * @param PLAYER the player making the move 
+	 * @brief Finds the symmetric game state with the smallest hash, which getCanonicalSymmetry and getCanonicalHash both return part of
+	 * @param canonicalHash set to the hash of the canonical form
+	 * @return symmetry from 0 to 7 which gives the canonical form
+	 */
+	unsigned int mFindCanonical(uint64_t& canonicalHash) const;
+	
+	/**
+	 * @brief Returns a bitboard with every valid move that wins a 3 by 3 board for the next player, found from a table for each 3 by 3
+	 *        board that can be played
+	 * @return all valid moves which win a 3 by 3 board
 	 */
-    static void mEditBoard(unsigned int (&board)[BOARD_SIDE_LENGTH][BOARD_SIDE_LENGTH], unsigned int (&miniBoard)[MINI_BOARD_SIDE_LENGTH][MINI_BOARD_SIDE_LENGTH], const int MOVE, const unsigned int PLAYER);
+	UTTTBitboard mGetBoardWinningCells() const;
 	
 	/**
-	 * @brief Returns the winner of a given 3 by 3 board with 0 for X, 1 for O, 2 for no winner, and 3 for a tie
-	 * @param MINI_BOARD 3 by 3 board
-	 * @return winner of board with 0 for X, 1 for O, 2 for no winner, and 3 for a tie
+	 * @brief Places a piece for a given player at a given move and updates the 3 by 3 board it was placed in
+	 * @param MOVE the current move
+	 * @param PLAYER the player making the move 
 	 */
-	static unsigned int mFindWinner(const unsigned int (&MINI_BOARD)[MINI_BOARD_SIDE_LENGTH][MINI_BOARD_SIDE_LENGTH]);
+	void mEditBoard(const int MOVE, const unsigned int PLAYER);
 };
 
 #endif
\ No newline at end of file
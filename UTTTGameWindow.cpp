@@ -5,6 +5,7 @@
 #include "UTTTGameWindow.h"
 
 #include <stdexcept>
+#include <thread>
 #include <CommCtrl.h>
 
 #define IDM_FILE_NEW 0
@@ -14,6 +15,7 @@
 #define IDM_TOGGLE_ICON 4
 #define IDM_TOGGLE_MULTIPLAYER 5
 #define IDM_SET_SIMULATIONS 6
+#define IDM_SET_THINK_TIME 7
 
 UTTTGameWindow::UTTTGameWindow() : mMCTS(NeuralNetwork<UTTTNet>(0), 0) {
 	mHInstance = GetModuleHandle(NULL);
@@ -23,6 +25,8 @@ UTTTGameWindow::UTTTGameWindow() : mMCTS(NeuralNetwork<UTTTNet>(0), 0) {
 	mComputer = NULL;
 	mComputerMove = -1;
 	mSimulations = 50;
+	mThinkTime = 0;
+	mInputThinkTime = false;
 	mWindow = {0,0,700,850};
 	mTopBar = {50,25,650,125};
 	mGameRect = {20,120,680,780};
@@ -103,13 +107,24 @@ UTTTGameWindow::UTTTGameWindow() : mMCTS(NeuralNetwork<UTTTNet>(0), 0) {
 	}
 	
 	mMCTS = MCTS<UTTTNet, UTTTGameState>(mNN, mSimulations);
+	mMCTS.setSolverThreshold(SOLVER_EMPTY_CELLS);
+	mMCTS.setBatchSize(EVALUATION_BATCH_SIZE);
+	mMCTS.setThreads(thread::hardware_concurrency());
+	mMCTS.setMemoryLimit(SEARCH_MEMORY_LIMIT);
+	mMCTS.setTimeLimit(mThinkTime);
 	
 	while (mProcessingMessages()) {
 		if (mComputerMove != -1) {
 			mGameState = mGameState.getChild(mComputerMove);
+			mMCTS.advanceRoot(mComputerMove);
 			mSaved = false;
 			InvalidateRect(mHWnd, NULL, TRUE);
 			mFinishThinking();
+			
+			//Searches while the player thinks so the tree under their move is already grown
+			if (!mMultiplayer) {
+				mMCTS.ponder(mGameState);
+			}
 		}
 		
 		Sleep(200);
@@ -126,6 +141,7 @@ UTTTGameWindow::~UTTTGameWindow() {
 void UTTTGameWindow::newGame() {
 	mFinishThinking();
     mGameState = UTTTGameState();
+	mMCTS.reset();
 	mSaved = false;
 	mStarted = true;
 	
@@ -154,6 +170,7 @@ void UTTTGameWindow::loadGame() {
 	} catch (invalid_argument ex) {
 		throw invalid_argument(ex.what());
 	}
+	mMCTS.reset();
 	
 	mStarted = true;
 	if (!mMultiplayer && mGameState.getNextPlayer() != mHumanIcon) {
@@ -227,6 +244,11 @@ void UTTTGameWindow::setSimulations(const int SIMULATIONS) {
 	mMCTS.setSimulations(mSimulations);
 }
 
+void UTTTGameWindow::setThinkTime(const int MILLISECONDS) {
+	mThinkTime = MILLISECONDS;
+	mMCTS.setTimeLimit(mThinkTime);
+}
+
 bool UTTTGameWindow::handleClick(int x, int y) {
 	if (mStarted && (mGameRect.left <= x && x <= mGameRect.right) && (mGameRect.top <= y && y <= mGameRect.bottom) && (mMultiplayer || mHumanIcon == mGameState.getNextPlayer())) {
 		bool outOfBounds = false;
@@ -243,6 +265,7 @@ bool UTTTGameWindow::handleClick(int x, int y) {
 		int move = j * 9 + i;
 		if (!outOfBounds && mGameState.isValid(move)) {
 			mGameState = mGameState.getChild(move);
+			mMCTS.advanceRoot(move);
 			mSaved = false;
 			
 			if (!mMultiplayer) {
@@ -257,15 +280,16 @@ bool UTTTGameWindow::handleClick(int x, int y) {
 	return false;
 }
 
-void UTTTGameWindow::createInputWindow() {
+void UTTTGameWindow::createInputWindow(const bool THINK_TIME) {
 	if (mHWndInput != NULL) {
 		ShowWindow(mHWndInput, SW_SHOWNORMAL);;
 	}
 	
+	mInputThinkTime = THINK_TIME;
 	mHWndInput = CreateWindowEx(
 		0,
 		TEXT("Input Class"), 
-		TEXT("Simulations"), 
+		THINK_TIME ? TEXT("Think Time") : TEXT("Simulations"), 
 		WS_POPUP | WS_BORDER,
 		25, 375, 400, 100,
 		mHWnd, 
@@ -288,12 +312,20 @@ void UTTTGameWindow::createInputWindow() {
 		NULL
 	);
 	
-	SendMessageW(hWndTrackBar, TBM_SETRANGE, TRUE, MAKELONG(50, 1000)); 
-	SendMessageW(hWndTrackBar, TBM_SETTIC, 0, 50);
-	SendMessageW(hWndTrackBar, TBM_SETTIC, 0, 100);
-	SendMessageW(hWndTrackBar, TBM_SETTIC, 0, 500);
-	SendMessageW(hWndTrackBar, TBM_SETTIC, 0, 1000);
-	SendMessageW(hWndTrackBar, TBM_SETPOS, TRUE, mSimulations);
+	if (THINK_TIME) {
+		SendMessageW(hWndTrackBar, TBM_SETRANGE, TRUE, MAKELONG(0, 10000)); 
+		SendMessageW(hWndTrackBar, TBM_SETTIC, 0, 1000);
+		SendMessageW(hWndTrackBar, TBM_SETTIC, 0, 5000);
+		SendMessageW(hWndTrackBar, TBM_SETTIC, 0, 10000);
+		SendMessageW(hWndTrackBar, TBM_SETPOS, TRUE, mThinkTime);
+	} else {
+		SendMessageW(hWndTrackBar, TBM_SETRANGE, TRUE, MAKELONG(50, 1000)); 
+		SendMessageW(hWndTrackBar, TBM_SETTIC, 0, 50);
+		SendMessageW(hWndTrackBar, TBM_SETTIC, 0, 100);
+		SendMessageW(hWndTrackBar, TBM_SETTIC, 0, 500);
+		SendMessageW(hWndTrackBar, TBM_SETTIC, 0, 1000);
+		SendMessageW(hWndTrackBar, TBM_SETPOS, TRUE, mSimulations);
+	}
 	
 	HWND hWndButton = CreateWindowEx(
 		0,
@@ -310,6 +342,10 @@ void UTTTGameWindow::createInputWindow() {
 	ShowWindow(mHWndInput, SW_SHOWNORMAL);
 }
 
+bool UTTTGameWindow::inputIsThinkTime() const {
+	return mInputThinkTime;
+}
+
 void UTTTGameWindow::saveGame() {
 	if (!mStarted) {
 		throw invalid_argument("You have to be in a game first.");
@@ -345,17 +381,7 @@ bool UTTTGameWindow::saved() {
 DWORD WINAPI UTTTGameWindow::calculateMove(LPVOID lpParam) {
 	UTTTGameWindow* pUTTTGameWindow = (UTTTGameWindow*)lpParam;
 	
-	vector<float> probs = pUTTTGameWindow->mMCTS.getBestMove(pUTTTGameWindow->mGameState);
-	
-	int move = -1;
-	for (int i=0;i<probs.size();i++) {
-		if (probs.at(i) == 1.0f) {
-			move = i;
-			break;
-		}
-	}
-	
-	pUTTTGameWindow->mComputerMove = move;
+	pUTTTGameWindow->mComputerMove = pUTTTGameWindow->mMCTS.search(pUTTTGameWindow->mGameState).bestMove;
 	return 0;
 }
 
@@ -391,6 +417,7 @@ void UTTTGameWindow::mAddMenu() {
 	AppendMenu(gameSettingsMenu, MF_POPUP, (UINT_PTR)playerIconMenu, TEXT("Set Player Icon"));
 	AppendMenu(gameSettingsMenu, MF_POPUP, IDM_SET_SIMULATIONS, TEXT("Set Simulations"));
 	AppendMenu(gameSettingsMenu, MF_POPUP, (UINT_PTR)multiplayerMenu, TEXT("Set Multiplayer"));
+	AppendMenu(gameSettingsMenu, MF_POPUP, IDM_SET_THINK_TIME, TEXT("Set Think Time"));
 	
 	AppendMenu(mMenuBar, MF_POPUP, (UINT_PTR)fileMenu, TEXT("File"));
 	AppendMenu(mMenuBar, MF_POPUP, (UINT_PTR)gameSettingsMenu, TEXT("Settings"));
@@ -491,16 +518,19 @@ bool UTTTGameWindow::mProcessingMessages() {
 }
 
 void UTTTGameWindow::mFinishThinking() {
+	mMCTS.stopPondering();
+	
 	if (mComputer == NULL) {
 		return;
 	}
 	
-	DWORD computerResult;
-	GetExitCodeThread(mComputer,&computerResult);
-	if (computerResult == STILL_ACTIVE) {
-		TerminateThread(mComputer, 0);
-	}
+	//Cancelling lets the search return on its own instead of killing it while it holds the tree or a lock, where batches waiting for the
+	//neural net or the server are dropped so the wait is at most the one forward pass already running
+	CancellationToken cancellation = mMCTS.getCancellationToken();
+	cancellation.cancel();
+	WaitForSingleObject(mComputer, INFINITE);
 	CloseHandle(mComputer);
+	cancellation.reset();
 	
 	mComputer = NULL;
 	mComputerMove = -1;
@@ -584,6 +614,9 @@ LRESULT CALLBACK WindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 				case IDM_SET_SIMULATIONS:
 					utttGameWindow->createInputWindow();
 					break;
+				case IDM_SET_THINK_TIME:
+					utttGameWindow->createInputWindow(true);
+					break;
 			}
 			break;
 		case WM_LBUTTONDOWN:
@@ -607,14 +640,22 @@ LRESULT CALLBACK InputWindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lPa
 			break;
 		case WM_HSCROLL:
 			result = SendMessageW(FindWindowEx(hWnd, NULL, TRACKBAR_CLASS, NULL), TBM_GETPOS, 0, 0);
-			message = "Set the number of simulations to " + to_string(result);
+			if (utttGameWindow->inputIsThinkTime()) {
+				message = result == 0 ? "Use the number of simulations instead" : "Set the think time to " + to_string(result) + " ms";
+			} else {
+				message = "Set the number of simulations to " + to_string(result);
+			}
 			SetWindowTextA(FindWindowEx(hWnd, NULL, TEXT("BUTTON"), NULL), message.c_str());
 			break;
 		case WM_COMMAND:	
 			switch(wParam) {
 				case BN_CLICKED:
 					result = SendMessageW(FindWindowEx(hWnd, NULL, TRACKBAR_CLASS, NULL), TBM_GETPOS, 0, 0);
-					utttGameWindow->setSimulations(result);
+					if (utttGameWindow->inputIsThinkTime()) {
+						utttGameWindow->setThinkTime(result);
+					} else {
+						utttGameWindow->setSimulations(result);
+					}
 					utttGameWindow = nullptr;
 					DestroyWindow(hWnd);
 					break;
@@ -63,6 +63,12 @@ public:
 	 */
 	void setSimulations(const int SIMULATIONS);
 	
+	/**
+	 * @brief Set how long the computer thinks about each move, which replaces the number of simulations unless it is 0
+	 * @param MILLISECONDS milliseconds the computer searches for, 0 to search for the set number of simulations instead
+	 */
+	void setThinkTime(const int MILLISECONDS);
+	
 	/**
 	 * @brief If click corresponds to a valid move and it is the human player's turn, applies move and returns true
 	 * @param X x position of click
@@ -73,8 +79,15 @@ public:
 	
 	/**
 	 * @brief Creates and launches input window
+	 * @param THINK_TIME whether the input window sets the think time instead of the number of simulations
+	 */
+	void createInputWindow(const bool THINK_TIME = false);
+	
+	/**
+	 * @brief Returns whether the input window sets the think time instead of the number of simulations
+	 * @return true if the input window sets the think time, false otherwise
 	 */
-	void createInputWindow();
+	bool inputIsThinkTime() const;
 	
 	/**
 	 * @brief Creates a popup asking the user to pick a file name and saves game state there
@@ -111,6 +124,14 @@ private:
 	 * @brief number of simulations the computer should do in MCTS
 	 */
 	int mSimulations;
+	/**
+	 * @brief milliseconds the computer should think about each move, 0 if it does the number of simulations instead
+	 */
+	int mThinkTime;
+	/**
+	 * @brief whether the input window sets the think time instead of the number of simulations
+	 */
+	bool mInputThinkTime;
 	/**
 	 * @brief whether the current game state has been saved
 	 */
@@ -228,7 +249,7 @@ private:
 	bool mProcessingMessages();
 	
 	/**
-	 * @brief Stops the computer's thought process
+	 * @brief Stops the computer's thought process, including the search it runs while the player thinks
 	 */
 	void mFinishThinking();
 	
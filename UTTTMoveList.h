@@ -0,0 +1,76 @@
+/* Author: Hanuman Chu
+ *
+ * Creates UTTTMoveList class which holds up to 81 moves in place so that listing moves never allocates memory
+ */
+#ifndef UTTT_MOVE_LIST_H
+#define UTTT_MOVE_LIST_H
+
+const unsigned int MOVE_LIST_CAPACITY = 81;
+
+class UTTTMoveList {
+public:
+	/**
+	 * @brief Constructor which creates an empty move list
+	 */
+	UTTTMoveList() : mSize(0) {}
+
+	/**
+	 * @brief Adds a move to the end of the list, the list must not be full
+	 * @param MOVE move to add
+	 */
+	void push_back(const unsigned int MOVE) {
+		mMoves[mSize++] = (unsigned char)MOVE;
+	}
+
+	/**
+	 * @brief Returns the move at a given position
+	 * @param INDEX position of the move
+	 * @return move at that position
+	 */
+	unsigned int operator[](const unsigned int INDEX) const {
+		return mMoves[INDEX];
+	}
+
+	/**
+	 * @brief Returns the number of moves in the list
+	 * @return number of moves
+	 */
+	unsigned int size() const {
+		return mSize;
+	}
+
+	/**
+	 * @brief Returns whether the list has no moves
+	 * @return true if the list is empty, false otherwise
+	 */
+	bool empty() const {
+		return mSize == 0;
+	}
+
+	/**
+	 * @brief Returns a pointer to the first move for range based for loops
+	 * @return pointer to the first move
+	 */
+	const unsigned char* begin() const {
+		return mMoves;
+	}
+
+	/**
+	 * @brief Returns a pointer past the last move for range based for loops
+	 * @return pointer past the last move
+	 */
+	const unsigned char* end() const {
+		return mMoves + mSize;
+	}
+private:
+	/**
+	 * @brief holds the moves, each of which fits in one byte
+	 */
+	unsigned char mMoves[MOVE_LIST_CAPACITY];
+	/**
+	 * @brief the number of moves in the list
+	 */
+	unsigned int mSize;
+};
+
+#endif
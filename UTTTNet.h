@@ -16,17 +16,20 @@ struct UTTTNetImpl : public nn::Module {
 	nn::BatchNorm2d mBn1, mBn2, mBn3, mBn4;
 	nn::Linear mFc1, mFc2, mFc3, mFc4;
 	nn::BatchNorm1d mFcBn1, mFcBn2;
+	int64_t mInputPlanes;
 	
 	/**
 	 * @brief Constructor which initializes neural net layers
+	 * @param INPUT_PLANES number of 9 by 9 planes in each input, 1 for just the board
 	 */
-	UTTTNetImpl() : 
-		mConv1(nn::Conv2dOptions(1, 512, 3).stride(1).padding(1)),
+	UTTTNetImpl(const int64_t INPUT_PLANES = 1) : 
+		mConv1(nn::Conv2dOptions(INPUT_PLANES, 512, 3).stride(1).padding(1)),
 		mConv2(nn::Conv2dOptions(512, 512, 3).stride(1).padding(1)),
 		mConv3(nn::Conv2dOptions(512, 512, 3).stride(1)),
 		mConv4(nn::Conv2dOptions(512, 512, 3).stride(1)),
 		mBn1(512), mBn2(512), mBn3(512), mBn4(512),
-		mFc1(512 * 5 * 5, 1024), mFcBn1(1024), mFc2(1024, 512), mFcBn2(512), mFc3(512, 9 * 9), mFc4(512, 1)
+		mFc1(512 * 5 * 5, 1024), mFcBn1(1024), mFc2(1024, 512), mFcBn2(512), mFc3(512, 9 * 9), mFc4(512, 1),
+		mInputPlanes(INPUT_PLANES)
 	{
 		register_module("conv1",mConv1);
 		register_module("conv2",mConv2);
@@ -51,7 +54,7 @@ struct UTTTNetImpl : public nn::Module {
 	 *         second entry contains values for the corresponding game boards
 	 */
 	vector<Tensor> forward(Tensor x) {
-		x = x.view({-1, 1, 9, 9}); //batchSize, 1, 9, 9
+		x = x.view({-1, mInputPlanes, 9, 9}); //batchSize, inputPlanes, 9, 9
 		
 		x = relu(mBn1(mConv1(x))); //batchSize by 512 by 9 by 9
 		x = relu(mBn2(mConv2(x))); //batchSize by 512 by 9 by 9
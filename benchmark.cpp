@@ -0,0 +1,334 @@
+/* Author: Hanuman Chu
+ *
+ * Times the table driven 3 by 3 winner check against the row, column and diagonal summing loop it replaced, then measures random playout
+ * and random playout MCTS throughput, including through an inference server, as a baseline that does not need libtorch, along with how
+ * quickly a cancelled search stops waiting on the server and how closely a search keeps to a time limit
+ */
+#include "UTTTBitboard.h"
+#include "UTTTGameState.h"
+#include "RandomPlayouts.hpp"
+#include "MCTS.hpp"
+#include "InferenceServer.hpp"
+
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <thread>
+using namespace std;
+
+const unsigned int BOARD_COUNT = 4096;
+const unsigned int REPETITIONS = 2000;
+const unsigned int PLAYOUTS = 200000;
+const unsigned int BENCHMARK_SIMULATIONS = 20000;
+const unsigned int SERVER_CLIENT_THREADS = 4;
+const unsigned int BENCHMARK_TIME_LIMIT = 100;
+const unsigned int CANCELLED_SERVER_DEADLINE = 2000000;
+const unsigned int CANCEL_AFTER = 20;
+
+/**
+ * @brief 3 by 3 board in the array format the loop based check reads
+ */
+struct MiniBoard {
+	unsigned int cells[3][3];
+};
+
+/**
+ * @brief Returns the winner of a 3 by 3 board by summing its rows, columns and diagonals, kept as the baseline to compare against
+ * @param MINI_BOARD 3 by 3 board with 0 for X, 1 for O, and 2 for empty cells
+ * @return winner of board with 0 for X, 1 for O, 2 for no winner, and 3 for a tie
+ */
+unsigned int loopFindWinner(const unsigned int (&MINI_BOARD)[3][3]) {
+	int sums[5] = {0,0,0,0,0};
+	bool tie = true;
+	for (unsigned int i=0;i<3;i++) {
+		int rowsum = 0;
+		for (unsigned int j=0;j<3;j++) {
+			switch (MINI_BOARD[i][j]) {
+				case 0:
+					rowsum++;
+					sums[j]++;
+					if (i == j) {
+						sums[3]++;
+					}
+					if (i + j + 1 == 3) {
+						sums[4]++;
+					}
+					break;
+				case 1:
+					rowsum--;
+					sums[j]--;
+					if (i == j) {
+						sums[3]--;
+					}
+					if (i + j + 1 == 3) {
+						sums[4]--;
+					}
+					break;
+				case 2:
+					tie = false;
+					break;
+			}
+		}
+
+		if (rowsum == 3) {
+			return 0;
+		} else if (rowsum == -3) {
+			return 1;
+		}
+	}
+
+	for (int sum:sums) {
+		if (sum == 3) {
+			return 0;
+		}
+	}
+	for (int sum:sums) {
+		if (sum == -3) {
+			return 1;
+		}
+	}
+	if (tie) {
+		return 3;
+	}
+	return 2;
+}
+
+/**
+ * @brief Lists the valid moves which win a 3 by 3 board for the next player by playing each of them, kept as the reference the moves
+ *        picked by position from the bitboards are checked against
+ * @param GAME_STATE game state to list the moves of
+ * @return valid moves which win a 3 by 3 board in the order getValidMoves lists them
+ */
+UTTTMoveList referenceBoardWinningMoves(const UTTTGameState& GAME_STATE) {
+	UTTTMoveList moves;
+	for (int move:GAME_STATE.getValidMoves()) {
+		const unsigned int BOARD = move / 27 * 3 + move % 9 / 3;
+		if (GAME_STATE.getChild(move).getMiniBoard()[BOARD] == (float)GAME_STATE.getNextPlayer()) {
+			moves.push_back(move);
+		}
+	}
+	
+	return moves;
+}
+
+int main() {
+	default_random_engine generator(0);
+	uniform_int_distribution<unsigned int> distribution(0, 2);
+
+	vector<MiniBoard> boards(BOARD_COUNT);
+	vector<unsigned int> xMasks, oMasks;
+	for (unsigned int board=0;board<BOARD_COUNT;board++) {
+		unsigned int xMask = 0, oMask = 0;
+		for (unsigned int cell=0;cell<9;cell++) {
+			boards[board].cells[cell / 3][cell % 3] = distribution(generator);
+			if (boards[board].cells[cell / 3][cell % 3] == 0) {
+				xMask |= 1 << cell;
+			} else if (boards[board].cells[cell / 3][cell % 3] == 1) {
+				oMask |= 1 << cell;
+			}
+		}
+		xMasks.push_back(xMask);
+		oMasks.push_back(oMask);
+	}
+
+	for (unsigned int board=0;board<BOARD_COUNT;board++) {
+		unsigned int expected = loopFindWinner(boards[board].cells);
+		unsigned int actual = findWinner(xMasks[board], oMasks[board], xMasks[board] | oMasks[board]);
+		//A random board can have lines for both players, in which case the two checks may pick different winners
+		if (expected != actual && !(WIN_TABLE.complete[xMasks[board]] && WIN_TABLE.complete[oMasks[board]])) {
+			cout << "Mismatch on board " << board << ": loop gave " << expected << ", table gave " << actual << endl;
+			return 1;
+		}
+	}
+
+	unsigned int checksum = 0;
+	chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+	for (unsigned int repetition=0;repetition<REPETITIONS;repetition++) {
+		for (unsigned int board=0;board<BOARD_COUNT;board++) {
+			checksum += loopFindWinner(boards[board].cells);
+		}
+	}
+	double loopSeconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+
+	begin = chrono::steady_clock::now();
+	for (unsigned int repetition=0;repetition<REPETITIONS;repetition++) {
+		for (unsigned int board=0;board<BOARD_COUNT;board++) {
+			checksum += findWinner(xMasks[board], oMasks[board], xMasks[board] | oMasks[board]);
+		}
+	}
+	double tableSeconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+
+	double calls = (double)BOARD_COUNT * REPETITIONS;
+	cout << "Loop winner check: " << loopSeconds * 1e9 / calls << " ns per board" << endl;
+	cout << "Table winner check: " << tableSeconds * 1e9 / calls << " ns per board" << endl;
+	cout << "Speedup: " << loopSeconds / tableSeconds << "x" << endl;
+	cout << "Checksum: " << checksum << endl;
+	
+	//Moves picked by position from the bitboards have to match the move lists playouts used to build
+	for (unsigned int game=0;game<BOARD_COUNT;game++) {
+		UTTTGameState gameState;
+		while (gameState.getEnd() == 2) {
+			UTTTMoveList validMoves = gameState.getValidMoves(), winningMoves = referenceBoardWinningMoves(gameState);
+			bool matches = validMoves.size() == gameState.getValidMoveCount() && winningMoves.size() == gameState.getBoardWinningMoveCount();
+			for (unsigned int i=0;i<validMoves.size() && matches;i++) {
+				matches = (int)validMoves[i] == gameState.getValidMove(i);
+			}
+			for (unsigned int i=0;i<winningMoves.size() && matches;i++) {
+				matches = (int)winningMoves[i] == gameState.getBoardWinningMove(i);
+			}
+			if (!matches) {
+				cout << "Mismatch between move lists and moves picked by position in game " << game << endl;
+				return 1;
+			}
+			
+			//The playout path has to reach the same game state as a normal move apart from the hash it leaves alone
+			const int MOVE = validMoves[generator() % validMoves.size()];
+			UTTTGameState playoutGameState = gameState;
+			playoutGameState.applyPlayoutMove(MOVE);
+			gameState.applyMove(MOVE);
+			if (playoutGameState.getBoard() != gameState.getBoard() || playoutGameState.getMiniBoard() != gameState.getMiniBoard() ||
+				playoutGameState.getEnd() != gameState.getEnd() || playoutGameState.getNextPlayer() != gameState.getNextPlayer() ||
+				playoutGameState.getValidMoveCount() != gameState.getValidMoveCount()) {
+				cout << "Playout move " << MOVE << " reached a different game state in game " << game << endl;
+				return 1;
+			}
+		}
+	}
+	
+	RandomPlayouts randomPlayouts;
+	float totalValue = 0.0f;
+	begin = chrono::steady_clock::now();
+	for (unsigned int playout=0;playout<PLAYOUTS;playout++) {
+		totalValue += randomPlayouts.playout(UTTTGameState());
+	}
+	double playoutSeconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+	cout << "Random playouts: " << PLAYOUTS / playoutSeconds << " per second, average value " << totalValue / PLAYOUTS << endl;
+	
+	//Early stopping is off wherever simulations per second are measured so every simulation is run
+	MCTS<RandomPlayouts, UTTTGameState> mcts(RandomPlayouts(), BENCHMARK_SIMULATIONS);
+	mcts.setEarlyStopping(false);
+	begin = chrono::steady_clock::now();
+	vector<float> bestMove = mcts.getBestMove(UTTTGameState());
+	double mctsSeconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+	cout << "Random playout MCTS: " << BENCHMARK_SIMULATIONS / mctsSeconds << " simulations per second, best first move "
+		 << max_element(bestMove.begin(), bestMove.end()) - bestMove.begin() << endl;
+	
+	const unsigned int THREADS = thread::hardware_concurrency() < 1 ? 1 : thread::hardware_concurrency();
+	MCTS<RandomPlayouts, UTTTGameState> parallelMCTS(RandomPlayouts(), BENCHMARK_SIMULATIONS * THREADS);
+	parallelMCTS.setThreads(THREADS);
+	parallelMCTS.setEarlyStopping(false);
+	begin = chrono::steady_clock::now();
+	bestMove = parallelMCTS.getBestMove(UTTTGameState());
+	mctsSeconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+	cout << "Random playout MCTS with " << THREADS << " threads: " << BENCHMARK_SIMULATIONS * THREADS / mctsSeconds
+		 << " simulations per second, best first move " << max_element(bestMove.begin(), bestMove.end()) - bestMove.begin() << endl;
+	
+	MCTS<RandomPlayouts, UTTTGameState> rootParallelMCTS(RandomPlayouts(), BENCHMARK_SIMULATIONS * THREADS);
+	rootParallelMCTS.setRootTrees(THREADS);
+	rootParallelMCTS.setEarlyStopping(false);
+	begin = chrono::steady_clock::now();
+	bestMove = rootParallelMCTS.getBestMove(UTTTGameState());
+	mctsSeconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+	cout << "Random playout MCTS with " << THREADS << " root parallel trees: " << BENCHMARK_SIMULATIONS * THREADS / mctsSeconds
+		 << " simulations per second, best first move " << max_element(bestMove.begin(), bestMove.end()) - bestMove.begin() << endl;
+	
+	//Two searches with several threads each share one server so their leaves can be evaluated in the same batches
+	InferenceServer<RandomPlayouts, UTTTGameState> server(randomPlayouts);
+	MCTS<InferenceServer<RandomPlayouts, UTTTGameState>, UTTTGameState> firstServerMCTS(server, BENCHMARK_SIMULATIONS);
+	MCTS<InferenceServer<RandomPlayouts, UTTTGameState>, UTTTGameState> secondServerMCTS(server, BENCHMARK_SIMULATIONS);
+	firstServerMCTS.setThreads(SERVER_CLIENT_THREADS);
+	secondServerMCTS.setThreads(SERVER_CLIENT_THREADS);
+	firstServerMCTS.setBatchSize(EVALUATION_BATCH_SIZE);
+	secondServerMCTS.setBatchSize(EVALUATION_BATCH_SIZE);
+	firstServerMCTS.setEarlyStopping(false);
+	secondServerMCTS.setEarlyStopping(false);
+	begin = chrono::steady_clock::now();
+	thread secondSearch([&secondServerMCTS]() {
+		secondServerMCTS.getBestMove(UTTTGameState());
+	});
+	firstServerMCTS.getBestMove(UTTTGameState());
+	secondSearch.join();
+	mctsSeconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+	cout << "Random playout MCTS through an inference server: " << 2 * BENCHMARK_SIMULATIONS / mctsSeconds << " simulations per second, "
+		 << server.getAverageBatchSize() << " game states per batch" << endl;
+	
+	//A move sharing an edge with the move representing it keeps that edge's subtree turned into its own frame, so two identical trees
+	//advanced by either move continue with the same visits on corresponding moves
+	const int REPRESENTED_MOVE = 0, SYMMETRIC_MOVE = 80;
+	vector<SearchResult> advancedResults;
+	for (int advancedMove:{REPRESENTED_MOVE, SYMMETRIC_MOVE}) {
+		MCTS<RandomPlayouts, UTTTGameState> symmetricMCTS(RandomPlayouts(), BENCHMARK_SIMULATIONS);
+		symmetricMCTS.setUseSymmetries(true);
+		symmetricMCTS.setEarlyStopping(false);
+		symmetricMCTS.search(UTTTGameState());
+		symmetricMCTS.advanceRoot(advancedMove);
+		symmetricMCTS.setSimulations(1);
+		advancedResults.push_back(symmetricMCTS.search(UTTTGameState().getChild(advancedMove)));
+	}
+	const UTTTGameState REPRESENTED_CHILD = UTTTGameState().getChild(REPRESENTED_MOVE);
+	const UTTTGameState SYMMETRIC_CHILD = UTTTGameState().getChild(SYMMETRIC_MOVE);
+	unsigned int symmetry = 0;
+	while (REPRESENTED_CHILD.getSymmetricHash(symmetry) != SYMMETRIC_CHILD.getHash()) {
+		symmetry++;
+	}
+	float advancedVisits = 0.0f;
+	for (int move:REPRESENTED_CHILD.getValidMoves()) {
+		advancedVisits += advancedResults[0].visits[move];
+		if (advancedResults[0].visits[move] != advancedResults[1].visits[UTTTGameState::getSymmetricMove(move, symmetry)]) {
+			cout << "Advancing the root by a symmetric move gave move " << UTTTGameState::getSymmetricMove(move, symmetry) << " "
+				 << advancedResults[1].visits[UTTTGameState::getSymmetricMove(move, symmetry)] << " visits instead of "
+				 << advancedResults[0].visits[move] << endl;
+			return 1;
+		}
+	}
+	if (advancedVisits <= 1.0f) {
+		cout << "Advancing the root did not keep the searched subtree" << endl;
+		return 1;
+	}
+	
+	//A game state with one valid move is answered without running a single simulation
+	UTTTGameState forcedGameState;
+	while (forcedGameState.getEnd() == 2 && forcedGameState.getValidMoveCount() != 1) {
+		forcedGameState.applyMove(forcedGameState.getValidMove(generator() % forcedGameState.getValidMoveCount()));
+		if (forcedGameState.getEnd() != 2) {
+			forcedGameState = UTTTGameState();
+		}
+	}
+	MCTS<RandomPlayouts, UTTTGameState> forcedMCTS(RandomPlayouts(), BENCHMARK_SIMULATIONS);
+	SearchResult forcedResult = forcedMCTS.search(forcedGameState);
+	if (forcedResult.simulations != 0 || forcedResult.bestMove != forcedGameState.getValidMove(0)) {
+		cout << "Search with one valid move ran " << forcedResult.simulations << " simulations and returned move " << forcedResult.bestMove << endl;
+		return 1;
+	}
+	
+	//A search cancelled while its batch waits on a server gives the batch up instead of waiting the server's deadline out
+	InferenceServer<RandomPlayouts, UTTTGameState> slowServer(randomPlayouts, SERVER_MAX_BATCH_SIZE, CANCELLED_SERVER_DEADLINE);
+	MCTS<InferenceServer<RandomPlayouts, UTTTGameState>, UTTTGameState> cancelledMCTS(slowServer, BENCHMARK_SIMULATIONS);
+	cancelledMCTS.setEarlyStopping(false);
+	CancellationToken cancellation = cancelledMCTS.getCancellationToken();
+	begin = chrono::steady_clock::now();
+	thread canceller([&cancellation]() {
+		this_thread::sleep_for(chrono::milliseconds(CANCEL_AFTER));
+		cancellation.cancel();
+	});
+	cancelledMCTS.search(UTTTGameState());
+	canceller.join();
+	mctsSeconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+	if (mctsSeconds * 1000000 >= CANCELLED_SERVER_DEADLINE / 2) {
+		cout << "Search cancelled after " << CANCEL_AFTER << " ms waited " << mctsSeconds * 1000 << " ms for the inference server" << endl;
+		return 1;
+	}
+	
+	MCTS<RandomPlayouts, UTTTGameState> timedMCTS(RandomPlayouts(), 1);
+	timedMCTS.setTimeLimit(BENCHMARK_TIME_LIMIT);
+	timedMCTS.setThreads(THREADS);
+	begin = chrono::steady_clock::now();
+	bestMove = timedMCTS.getBestMove(UTTTGameState());
+	mctsSeconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+	cout << "Random playout MCTS with a " << BENCHMARK_TIME_LIMIT << " ms time limit: finished in " << mctsSeconds * 1000
+		 << " ms, best first move " << max_element(bestMove.begin(), bestMove.end()) - bestMove.begin() << endl;
+
+	return 0;
+}
@@ -12,6 +12,7 @@
 #include <fstream>
 #include <chrono>
 #include <random>
+#include <thread>
 using namespace std;
 
 /**
@@ -61,6 +62,20 @@ void displayUTTTBoard(vector<float> board) {
 	}
 }
 
+/**
+ * @brief Applies the search settings every MCTS object in the trainer uses
+ * @param mcts MCTS object to set up
+ * @param GUMBEL_SEARCH whether the root picks moves by Gumbel top k sampling with sequential halving
+ * @param THREADS number of threads searching the tree
+ */
+void configureSearch(MCTS<UTTTNet, UTTTGameState>& mcts, const bool GUMBEL_SEARCH, const unsigned int THREADS) {
+	mcts.setSolverThreshold(SOLVER_EMPTY_CELLS);
+	mcts.setBatchSize(EVALUATION_BATCH_SIZE);
+	mcts.setThreads(THREADS);
+	mcts.setMemoryLimit(SEARCH_MEMORY_LIMIT);
+	mcts.setGumbel(GUMBEL_SEARCH);
+}
+
 int main(int argc, char* argv[]) {
 	NeuralNetwork<UTTTNet> curNN(81), prevNN(81);
 	if (argc >= 2) {
@@ -96,12 +111,25 @@ int main(int argc, char* argv[]) {
 		config.push_back(iTemp);
 		fin.ignore(numeric_limits<streamsize>::max(), '\n');
 	}
+	//Gumbel search and arena pondering were added later so config files without them still load, where a missing value reads as 0
+	for (int i=0;i<2;i++) {
+		fin >> iTemp;
+		config.push_back(fin.fail() ? 0 : iTemp);
+		fin.ignore(numeric_limits<streamsize>::max(), '\n');
+	}
 	fin.close();
 	
-	const int ITERATIONS = config.at(0), EPISODES = config.at(1), SIMULATIONS = config.at(2), GAMES = config.at(3), EXPLORATION_TURNS = config.at(4), BATCH_SIZE = config.at(5), LOAD_EXAMPLES = config.at(6), SKIP_TRAINING = config.at(7), DISPLAY_GAMES = config.at(8);
+	const int ITERATIONS = config.at(0), EPISODES = config.at(1), SIMULATIONS = config.at(2), GAMES = config.at(3), EXPLORATION_TURNS = config.at(4), BATCH_SIZE = config.at(5), LOAD_EXAMPLES = config.at(6), SKIP_TRAINING = config.at(7), DISPLAY_GAMES = config.at(8), GUMBEL_SEARCH = config.at(9), ARENA_PONDERING = config.at(10);
+	
+	//A pondering model searches at the same time as the model it plays, so each gets half of the threads to keep the machine from being
+	//oversubscribed and slowing down the model whose turn it is
+	const unsigned int SEARCH_THREADS = thread::hardware_concurrency() < 1 ? 1 : thread::hardware_concurrency();
+	const unsigned int ARENA_THREADS = ARENA_PONDERING != 0 ? max(1u, SEARCH_THREADS / 2) : SEARCH_THREADS;
 	
 	MCTS<UTTTNet, UTTTGameState> curMCTS = MCTS<UTTTNet, UTTTGameState>(curNN, SIMULATIONS);
 	MCTS<UTTTNet, UTTTGameState> prevMCTS = MCTS<UTTTNet, UTTTGameState>(prevNN, SIMULATIONS);
+	configureSearch(curMCTS, GUMBEL_SEARCH != 0, SEARCH_THREADS);
+	configureSearch(prevMCTS, GUMBEL_SEARCH != 0, ARENA_THREADS);
 	default_random_engine generator(chrono::system_clock::now().time_since_epoch().count());
 	for (int iteration=0;iteration<ITERATIONS;iteration++) {
 		cout << "Starting iteration " << iteration << endl;
@@ -139,6 +167,7 @@ int main(int argc, char* argv[]) {
 					int move = distribution(generator);
 					
 					gameState = gameState.getChild(move);
+					curMCTS.advanceRoot(move);
 					turns++;
 				}
 				float result;
@@ -163,6 +192,7 @@ int main(int argc, char* argv[]) {
 			}
 			
 			fout.close();
+			cout << "Evaluation cache hit rate: " << curNN.getCache()->getHitRate() * 100 << "%" << endl;
 		}
 		
 		if (SKIP_TRAINING == 0 || iteration != 0) {
@@ -215,6 +245,8 @@ int main(int argc, char* argv[]) {
 		
 		curMCTS = MCTS<UTTTNet, UTTTGameState>(curNN, SIMULATIONS);
 		prevMCTS = MCTS<UTTTNet, UTTTGameState>(prevNN, SIMULATIONS);
+		configureSearch(curMCTS, GUMBEL_SEARCH != 0, ARENA_THREADS);
+		configureSearch(prevMCTS, GUMBEL_SEARCH != 0, ARENA_THREADS);
 		
 		int prevWins = 0, curWins = 0;
 		for (int game=0;game<GAMES;game++) {
@@ -237,6 +269,13 @@ int main(int argc, char* argv[]) {
 					cout << results.second << endl;
 				}
 				
+				//The waiting model searches the same game state so the tree under the move played is already grown for its turn, which is
+				//off by default since its free search time then depends on how long the other model thinks and skews the win rates
+				if (ARENA_PONDERING != 0 && player == 0) {
+					curMCTS.ponder(gameState);
+				} else if (ARENA_PONDERING != 0) {
+					prevMCTS.ponder(gameState);
+				}
 				vector<float> probs = (player == 0) ? prevMCTS.getMoveProbs(gameState) : curMCTS.getMoveProbs(gameState);
 				
 				if (DISPLAY_GAMES != 0) {
@@ -253,6 +292,8 @@ int main(int argc, char* argv[]) {
 				}
 				
 				gameState = gameState.getChild(move);
+				prevMCTS.advanceRoot(move);
+				curMCTS.advanceRoot(move);
 				player = 1 - player;
 			}
 			
@@ -268,6 +309,8 @@ int main(int argc, char* argv[]) {
 		}
 		curMCTS.reset();
 		prevMCTS.reset();
+		//Self play in the next iteration has every thread to itself again
+		curMCTS.setThreads(SEARCH_THREADS);
 		
 		cout << "Previous model wins: " << prevWins << endl;
 		cout << "Current model wins: " << curWins << endl;